@@ -0,0 +1,116 @@
+#include <cstdlib>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "AutoTrim.hpp"
+#include "PixelKernels.hpp"
+#include "PixelFormat.hpp"
+
+namespace {
+  inline bool differs(quint32 a, quint32 b, int tolerance) {
+    for(int shift = 0; shift < 32; shift += 8) {
+      if(std::abs(int((a >> shift) & 0xff) - int((b >> shift) & 0xff)) > tolerance) return true;
+    }
+    return false;
+  }
+
+#ifdef __SSE2__
+  // Bit i of the result is set when any channel of pixel i is further than
+  // the tolerance from the border color.
+  inline int mismatchMask(const quint32* p, __m128i color, __m128i tolerance) {
+    __m128i px = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    __m128i diff = _mm_or_si128(_mm_subs_epu8(px, color), _mm_subs_epu8(color, px));
+    __m128i over = _mm_subs_epu8(diff, tolerance);
+    __m128i same = _mm_cmpeq_epi32(over, _mm_setzero_si128());
+    return ~_mm_movemask_ps(_mm_castsi128_ps(same)) & 0xf;
+  }
+#endif
+}
+
+int PixelKernels::firstMismatch(const quint32* row, int width, quint32 color, int tolerance)
+{
+  int x = 0;
+
+#ifdef __SSE2__
+  const __m128i vcolor = _mm_set1_epi32(color);
+  const __m128i vtolerance = _mm_set1_epi8(char(tolerance));
+
+  for(; x + 4 <= width; x += 4) {
+    int mask = mismatchMask(row + x, vcolor, vtolerance);
+    if(mask) return x + __builtin_ctz(mask);
+  }
+#endif
+
+  return firstMismatchScalar(row, width, color, tolerance, x);
+}
+
+int PixelKernels::firstMismatchScalar(const quint32* row, int width, quint32 color, int tolerance, int from)
+{
+  for(int x = from; x < width; ++x) {
+    if(differs(row[x], color, tolerance)) return x;
+  }
+  return -1;
+}
+
+int PixelKernels::lastMismatch(const quint32* row, int width, quint32 color, int tolerance)
+{
+  int x = width;
+
+#ifdef __SSE2__
+  const __m128i vcolor = _mm_set1_epi32(color);
+  const __m128i vtolerance = _mm_set1_epi8(char(tolerance));
+
+  for(; x >= 4; x -= 4) {
+    int mask = mismatchMask(row + x - 4, vcolor, vtolerance);
+    if(mask) return x - 4 + 31 - __builtin_clz(mask);
+  }
+#endif
+
+  return lastMismatchScalar(row, x, color, tolerance);
+}
+
+int PixelKernels::lastMismatchScalar(const quint32* row, int width, quint32 color, int tolerance)
+{
+  for(int x = width - 1; x >= 0; --x) {
+    if(differs(row[x], color, tolerance)) return x;
+  }
+  return -1;
+}
+
+QRect AutoTrim::contentRect(const QImage& image, int tolerance)
+{
+  QImage src = PixelFormat::toCanonical(image, "trim");
+  if(src.isNull()) return QRect();
+
+  int w = src.width();
+  int h = src.height();
+  tolerance = qBound(0, tolerance, 255);
+
+  auto line = [&](int y) { return reinterpret_cast<const quint32*>(src.constScanLine(y)); };
+  quint32 color = line(0)[0];
+
+  int top = 0;
+  while(top < h && PixelKernels::firstMismatch(line(top), w, color, tolerance) < 0) ++top;
+  if(top == h) return QRect();
+
+  int bottom = h - 1;
+  while(bottom > top && PixelKernels::firstMismatch(line(bottom), w, color, tolerance) < 0) --bottom;
+
+  // Only the rows between the uniform top and bottom bands can move the
+  // side edges, and each row stops at its first or last differing pixel.
+  int left = w - 1;
+  int right = 0;
+  for(int y = top; y <= bottom; ++y) {
+    auto row = line(y);
+
+    int first = PixelKernels::firstMismatch(row, left, color, tolerance);
+    if(first >= 0) left = first;
+
+    int last = PixelKernels::lastMismatch(row + right + 1, w - right - 1, color, tolerance);
+    if(last >= 0) right += last + 1;
+  }
+
+  return QRect(QPoint(left, top), QPoint(right, bottom));
+}
@@ -0,0 +1,11 @@
+#ifndef AUTOTRIM_H
+#define AUTOTRIM_H
+#include <QImage>
+#include <QRect>
+
+class AutoTrim
+{
+public:
+  static QRect contentRect(const QImage& image, int tolerance = 8);
+};
+#endif /* AUTOTRIM_H */
@@ -0,0 +1,105 @@
+#include <QPainter>
+#include <QStyleOptionGraphicsItem>
+#include <QtMath>
+#include <cmath>
+#include <algorithm>
+
+#include "CachedTextItem.hpp"
+#include "PixelFormat.hpp"
+
+namespace {
+  // Scales are cached in steps of 1/64.
+  const int SCALE_STEPS = 64;
+  const int MAX_SCALES = 3;
+  const qreal MAX_PIXELS = 4096.0 * 4096.0;
+}
+
+CachedTextItem::CachedTextItem(const QString& text, QGraphicsItem* parent)
+  : QGraphicsSimpleTextItem(text, parent)
+{
+}
+
+qint64 CachedTextItem::cacheBytes() const
+{
+  QMutexLocker lock(&mutex_);
+  qint64 ret = 0;
+
+  for(auto& image: cache_) ret += qint64(image.bytesPerLine()) * image.height();
+  return ret;
+}
+
+QImage CachedTextItem::raster(int key)
+{
+  // Tiled renders paint the same item from several threads.
+  QMutexLocker lock(&mutex_);
+
+  // The setters of the base class are not virtual, so changes are noticed
+  // here instead.
+  if(text_ != this -> text() || font_ != this -> font() || pen_ != this -> pen() || brush_ != this -> brush()) {
+    text_ = this -> text();
+    font_ = this -> font();
+    pen_ = this -> pen();
+    brush_ = this -> brush();
+    cache_.clear();
+  }
+
+  auto it = cache_.constFind(key);
+  if(it != cache_.constEnd()) return *it;
+
+  qreal scale = qreal(key) / SCALE_STEPS;
+  QRectF rect = this -> boundingRect().adjusted(-1, -1, 1, 1);
+  if(rect.width() * scale * rect.height() * scale > MAX_PIXELS) return QImage();
+
+  QImage image(qCeil(rect.width() * scale), qCeil(rect.height() * scale), PixelFormat::CANONICAL);
+  image.fill(Qt::transparent);
+
+  QPainter painter(&image);
+  painter.setRenderHints(QPainter::Antialiasing | QPainter::TextAntialiasing);
+  painter.scale(scale, scale);
+  painter.translate(-rect.topLeft());
+
+  QStyleOptionGraphicsItem option;
+  option.exposedRect = rect;
+  QGraphicsSimpleTextItem::paint(&painter, &option, 0);
+  painter.end();
+
+  if(cache_.size() >= MAX_SCALES) cache_.clear();
+  cache_.insert(key, image);
+
+  return image;
+}
+
+void CachedTextItem::paint(QPainter* painter, const QStyleOptionGraphicsItem* option, QWidget* widget)
+{
+  // Selected text is still being placed and needs the selection frame of
+  // the base class.
+  if(option -> state & QStyle::State_Selected) {
+    QGraphicsSimpleTextItem::paint(painter, option, widget);
+    return;
+  }
+
+  QTransform trans = painter -> deviceTransform();
+  qreal scale = std::max(std::hypot(trans.m11(), trans.m12()), std::hypot(trans.m21(), trans.m22()));
+  QImage image = this -> raster(std::max(1, qRound(scale * SCALE_STEPS)));
+
+  if(image.isNull()) {
+    QGraphicsSimpleTextItem::paint(painter, option, widget);
+    return;
+  }
+
+  QRectF rect = this -> boundingRect().adjusted(-1, -1, 1, 1);
+
+  painter -> save();
+  if(trans.type() <= QTransform::TxScale && trans.m11() > 0 && trans.m22() > 0) {
+    // Unrotated and unmirrored: put the raster on whole device pixels so it
+    // stays as sharp as the glyphs.
+    QPointF origin = trans.map(rect.topLeft());
+    painter -> resetTransform();
+    painter -> drawImage(QPoint(qRound(origin.x()), qRound(origin.y())), image);
+  }
+  else {
+    painter -> setRenderHint(QPainter::SmoothPixmapTransform);
+    painter -> drawImage(rect, image);
+  }
+  painter -> restore();
+}
@@ -0,0 +1,32 @@
+#ifndef CACHEDTEXTITEM_H
+#define CACHEDTEXTITEM_H
+#include <QGraphicsSimpleTextItem>
+#include <QMutex>
+#include <QHash>
+#include <QImage>
+#include <QFont>
+#include <QPen>
+#include <QBrush>
+
+// A text item painted from a raster made once per zoom level, so outlined
+// glyphs are not stroked again on every repaint. It keeps the type of
+// QGraphicsSimpleTextItem and is saved and measured like one.
+class CachedTextItem: public QGraphicsSimpleTextItem
+{
+public:
+  CachedTextItem(const QString& text = QString(), QGraphicsItem* parent = 0);
+
+  void paint(QPainter* painter, const QStyleOptionGraphicsItem* option, QWidget* widget);
+  qint64 cacheBytes() const;
+
+private:
+  QImage raster(int key);
+
+  mutable QMutex mutex_;
+  QString text_;
+  QFont font_;
+  QPen pen_;
+  QBrush brush_;
+  QHash<int, QImage> cache_;
+};
+#endif /* CACHEDTEXTITEM_H */
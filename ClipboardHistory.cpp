@@ -0,0 +1,72 @@
+#include <QCryptographicHash>
+
+#include "ClipboardHistory.hpp"
+#include "PixelFormat.hpp"
+#include "Qoi.hpp"
+
+namespace {
+  const qint64 BUDGET = 64 * 1024 * 1024;
+  const int MAX_ENTRIES = 20;
+  const int THUMBNAIL_SIZE = 48;
+}
+
+QList<ClipboardHistory::Entry> ClipboardHistory::entries_;
+
+void ClipboardHistory::add(const QImage& src)
+{
+  if(src.isNull()) return;
+
+  QImage image = PixelFormat::toCanonical(src, "history");
+  QCryptographicHash hash(QCryptographicHash::Sha1);
+  int size[] = {image.width(), image.height()};
+  hash.addData(reinterpret_cast<const char*>(size), sizeof(size));
+  for(int y = 0; y < image.height(); ++y)
+    hash.addData(reinterpret_cast<const char*>(image.constScanLine(y)), image.width() * 4);
+
+  // A known image only moves to the front and is not compressed again.
+  Entry entry;
+  entry.hash = hash.result();
+  for(int i = 0; i < entries_.size(); ++i) {
+    if(entries_[i].hash == entry.hash) {
+      entries_.move(i, 0);
+      return;
+    }
+  }
+
+  entry.data = Qoi::encode(image);
+  if(entry.data.isEmpty()) return;
+  entry.size = image.size();
+  entry.thumbnail = image.scaled(THUMBNAIL_SIZE, THUMBNAIL_SIZE, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+  entries_.prepend(entry);
+
+  // The newest entry is kept even when it alone is over the budget.
+  while(entries_.size() > 1 && (entries_.size() > MAX_ENTRIES || bytes() > BUDGET))
+    entries_.removeLast();
+}
+
+int ClipboardHistory::count()
+{
+  return entries_.size();
+}
+
+const ClipboardHistory::Entry& ClipboardHistory::entry(int index)
+{
+  return entries_.at(index);
+}
+
+QImage ClipboardHistory::image(int index)
+{
+  return Qoi::decode(entries_.at(index).data);
+}
+
+qint64 ClipboardHistory::entryBytes(const Entry& entry)
+{
+  return entry.data.size() + qint64(entry.thumbnail.bytesPerLine()) * entry.thumbnail.height();
+}
+
+qint64 ClipboardHistory::bytes()
+{
+  qint64 ret = 0;
+  for(auto& entry: entries_) ret += entryBytes(entry);
+  return ret;
+}
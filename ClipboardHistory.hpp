@@ -0,0 +1,28 @@
+#ifndef CLIPBOARDHISTORY_H
+#define CLIPBOARDHISTORY_H
+#include <QList>
+#include <QByteArray>
+#include <QImage>
+
+class ClipboardHistory
+{
+public:
+  struct Entry {
+    QByteArray hash;
+    QByteArray data;
+    QSize size;
+    QImage thumbnail;
+  };
+
+  static void add(const QImage& image);
+  static int count();
+  static const Entry& entry(int index);
+  static QImage image(int index);
+  static qint64 bytes();
+
+private:
+  static qint64 entryBytes(const Entry& entry);
+
+  static QList<Entry> entries_;
+};
+#endif /* CLIPBOARDHISTORY_H */
@@ -0,0 +1,248 @@
+#include <QApplication>
+#include <QMouseEvent>
+#include <QKeyEvent>
+#include <QWheelEvent>
+#include <QEventLoop>
+#include <QTimer>
+#include <iostream>
+
+#include "EventRecorder.hpp"
+#include "XRapture.hpp"
+#include "TimingStats.hpp"
+
+namespace {
+  const quint32 RECORD_MAGIC = 0x58525243; // "XRRC"
+  const quint32 RECORD_VERSION = 2;
+
+  enum Target {
+    VIEW = 0,
+    VIEWPORT = 1,
+  };
+}
+
+EventRecorder::EventRecorder(XRapture* view, const QString& fileName)
+  : QObject(view), view_(view), file_(fileName)
+{
+  if(file_.open(QIODevice::WriteOnly)) {
+    out_.setDevice(&file_);
+    out_.setVersion(QDataStream::Qt_5_0);
+    out_ << RECORD_MAGIC << RECORD_VERSION << view_ -> viewport() -> size();
+
+    view_ -> installEventFilter(this);
+    view_ -> viewport() -> installEventFilter(this);
+    connect(qApp, &QCoreApplication::aboutToQuit, this, [=] { file_.flush(); });
+  }
+  clock_.start();
+}
+
+bool EventRecorder::isOpen() const
+{
+  return file_.isOpen();
+}
+
+bool EventRecorder::eventFilter(QObject* watched, QEvent* event)
+{
+  quint8 target = (watched == view_) ? VIEW : VIEWPORT;
+
+  // Mouse and wheel events the viewport ignores propagate to the view, and
+  // key events go to the view; each is recorded only where it starts.
+  switch(event -> type()) {
+  case QEvent::MouseButtonPress:
+  case QEvent::MouseButtonRelease:
+  case QEvent::MouseButtonDblClick:
+  case QEvent::MouseMove: {
+    if(target != VIEWPORT) break;
+
+    auto e = static_cast<QMouseEvent*>(event);
+    out_ << qint64(clock_.nsecsElapsed()) << target << qint32(event -> type())
+         << e -> localPos() << e -> windowPos() << e -> screenPos()
+         << qint32(e -> button()) << qint32(e -> buttons()) << qint32(e -> modifiers());
+    break;
+  }
+  case QEvent::Wheel: {
+    if(target != VIEWPORT) break;
+
+    auto e = static_cast<QWheelEvent*>(event);
+    out_ << qint64(clock_.nsecsElapsed()) << target << qint32(event -> type())
+         << e -> posF() << e -> globalPosF() << e -> pixelDelta() << e -> angleDelta()
+         << qint32(e -> buttons()) << qint32(e -> modifiers());
+    break;
+  }
+  case QEvent::KeyPress:
+  case QEvent::KeyRelease: {
+    if(target != VIEW) break;
+
+    auto e = static_cast<QKeyEvent*>(event);
+    out_ << qint64(clock_.nsecsElapsed()) << target << qint32(event -> type())
+         << qint32(e -> key()) << qint32(e -> modifiers()) << e -> text() << e -> isAutoRepeat();
+    break;
+  }
+  default:
+    break;
+  }
+
+  return QObject::eventFilter(watched, event);
+}
+
+EventReplayer::EventReplayer(XRapture* view)
+  : view_(view)
+{
+}
+
+QEvent* EventReplayer::readEvent(QDataStream& in, QObject** target, qint64* time)
+{
+  quint8 where;
+  qint32 type;
+
+  in >> *time >> where >> type;
+  if(in.status() != QDataStream::Ok) return 0;
+
+  *target = (where == VIEW) ? static_cast<QObject*>(view_) : view_ -> viewport();
+
+  switch(type) {
+  case QEvent::MouseButtonPress:
+  case QEvent::MouseButtonRelease:
+  case QEvent::MouseButtonDblClick:
+  case QEvent::MouseMove: {
+    QPointF localPos, windowPos, screenPos;
+    qint32 button, buttons, modifiers;
+    in >> localPos >> windowPos >> screenPos >> button >> buttons >> modifiers;
+
+    return new QMouseEvent(QEvent::Type(type), localPos, windowPos, screenPos,
+                           Qt::MouseButton(button), Qt::MouseButtons(buttons),
+                           Qt::KeyboardModifiers(modifiers));
+  }
+  case QEvent::Wheel: {
+    QPointF pos, globalPos;
+    QPoint pixelDelta, angleDelta;
+    qint32 buttons, modifiers;
+    in >> pos >> globalPos >> pixelDelta >> angleDelta >> buttons >> modifiers;
+
+#if QT_VERSION >= QT_VERSION_CHECK(5, 12, 0)
+    return new QWheelEvent(pos, globalPos, pixelDelta, angleDelta,
+                           Qt::MouseButtons(buttons), Qt::KeyboardModifiers(modifiers),
+                           Qt::NoScrollPhase, false);
+#else
+    return new QWheelEvent(pos, globalPos, pixelDelta, angleDelta, angleDelta.y(), Qt::Vertical,
+                           Qt::MouseButtons(buttons), Qt::KeyboardModifiers(modifiers));
+#endif
+  }
+  case QEvent::KeyPress:
+  case QEvent::KeyRelease: {
+    qint32 key, modifiers;
+    QString text;
+    bool autoRepeat;
+    in >> key >> modifiers >> text >> autoRepeat;
+
+    return new QKeyEvent(QEvent::Type(type), key, Qt::KeyboardModifiers(modifiers), text, autoRepeat);
+  }
+  default:
+    in.setStatus(QDataStream::ReadCorruptData);
+    return 0;
+  }
+}
+
+bool EventReplayer::run(const QString& fileName, const QString& goldenFile, double budget)
+{
+  QFile file(fileName);
+  if(!file.open(QIODevice::ReadOnly)) {
+    std::cerr << "cannot open " << fileName.toStdString() << std::endl;
+    return false;
+  }
+
+  QDataStream in(&file);
+  in.setVersion(QDataStream::Qt_5_0);
+
+  quint32 magic, version;
+  QSize size;
+  in >> magic >> version >> size;
+  if(magic != RECORD_MAGIC || version != RECORD_VERSION) {
+    std::cerr << "invalid recording " << fileName.toStdString() << std::endl;
+    return false;
+  }
+
+  if(size != view_ -> viewport() -> size())
+    std::cerr << "warning: viewport size differs from the recording" << std::endl;
+
+  TimingStats handling, frames;
+  QElapsedTimer timer, clock;
+  qint64 start = -1;
+
+  while(!in.atEnd()) {
+    QObject* target;
+    qint64 time;
+    QEvent* event = this -> readEvent(in, &target, &time);
+    if(event == 0) {
+      std::cerr << "corrupt recording " << fileName.toStdString() << std::endl;
+      return false;
+    }
+
+    // Events are delivered at their recorded pace, so frame timers and
+    // coalescing see the same input pattern as the recording.
+    if(start < 0) {
+      start = time;
+      clock.start();
+    }
+    qint64 wait = (time - start - clock.nsecsElapsed()) / 1000000;
+    if(wait > 0) {
+      QEventLoop loop;
+      QTimer::singleShot(int(wait), Qt::PreciseTimer, &loop, &QEventLoop::quit);
+      loop.exec();
+    }
+
+    timer.start();
+    QApplication::sendEvent(target, event);
+    QApplication::processEvents();
+    handling.add(timer.nsecsElapsed());
+    delete event;
+
+    timer.start();
+    view_ -> viewport() -> repaint();
+    frames.add(timer.nsecsElapsed());
+  }
+
+  handling.report("event");
+  frames.report("frame");
+
+  bool ok = true;
+
+  if(budget > 0 && (handling.percentile(95) + frames.percentile(95)) / 1000000.0 > budget) {
+    std::cerr << "FAIL: p95 event + frame time exceeds " << budget << " ms" << std::endl;
+    ok = false;
+  }
+
+  if(!goldenFile.isEmpty()) {
+    QImage result = view_ -> getCurrentImage().convertToFormat(QImage::Format_ARGB32);
+    QImage golden(goldenFile);
+
+    if(golden.isNull()) {
+      result.save(goldenFile);
+      std::cerr << "golden image written to " << goldenFile.toStdString() << std::endl;
+    }
+    else {
+      golden = golden.convertToFormat(QImage::Format_ARGB32);
+
+      if(golden.size() != result.size()) {
+        std::cerr << "FAIL: image size differs from the golden image" << std::endl;
+        ok = false;
+      }
+      else {
+        qint64 diff = 0;
+        for(int y = 0; y < result.height(); ++y) {
+          auto a = reinterpret_cast<const QRgb*>(result.constScanLine(y));
+          auto b = reinterpret_cast<const QRgb*>(golden.constScanLine(y));
+
+          for(int x = 0; x < result.width(); ++x)
+            if(a[x] != b[x]) ++diff;
+        }
+
+        if(diff != 0) {
+          std::cerr << "FAIL: " << diff << " pixels differ from the golden image" << std::endl;
+          ok = false;
+        }
+      }
+    }
+  }
+
+  return ok;
+}
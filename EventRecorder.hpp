@@ -0,0 +1,36 @@
+#ifndef EVENTRECORDER_H
+#define EVENTRECORDER_H
+#include <QObject>
+#include <QFile>
+#include <QDataStream>
+#include <QElapsedTimer>
+
+class XRapture;
+class QEvent;
+
+class EventRecorder : public QObject
+{
+public:
+  EventRecorder(XRapture* view, const QString& fileName);
+  bool isOpen() const;
+  bool eventFilter(QObject* watched, QEvent* event);
+
+private:
+  XRapture* view_;
+  QFile file_;
+  QDataStream out_;
+  QElapsedTimer clock_;
+};
+
+class EventReplayer
+{
+public:
+  EventReplayer(XRapture* view);
+  bool run(const QString& fileName, const QString& goldenFile, double budget);
+
+private:
+  QEvent* readEvent(QDataStream& in, QObject** target, qint64* time);
+
+  XRapture* view_;
+};
+#endif /* EVENTRECORDER_H */
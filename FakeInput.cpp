@@ -0,0 +1,28 @@
+#include <QX11Info>
+#include <cstdlib>
+
+#include "FakeInput.hpp"
+
+#include <X11/Xlib.h>
+#include <X11/extensions/XTest.h>
+
+bool FakeInput::scroll(const QPoint& pos, int clicks)
+{
+  // Qt's own connection; the events are flushed below.
+  Display* display = QX11Info::display();
+  int event, error, major, minor;
+
+  if(display == 0 || !XTestQueryExtension(display, &event, &error, &major, &minor)) return false;
+
+  // Buttons 4 and 5 are the wheel up and down.
+  unsigned int button = (clicks < 0) ? 4 : 5;
+
+  XTestFakeMotionEvent(display, -1, pos.x(), pos.y(), CurrentTime);
+  for(int i = 0; i < std::abs(clicks); ++i) {
+    XTestFakeButtonEvent(display, button, True, CurrentTime);
+    XTestFakeButtonEvent(display, button, False, CurrentTime);
+  }
+  XFlush(display);
+
+  return true;
+}
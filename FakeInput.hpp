@@ -0,0 +1,10 @@
+#ifndef FAKEINPUT_H
+#define FAKEINPUT_H
+#include <QPoint>
+
+class FakeInput
+{
+public:
+  static bool scroll(const QPoint& pos, int clicks);
+};
+#endif /* FAKEINPUT_H */
@@ -0,0 +1,62 @@
+#include <QSocketNotifier>
+#include <QImageReader>
+#include <QFileInfo>
+#include <QDir>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include "FolderWatcher.hpp"
+
+FolderWatcher::FolderWatcher(const QString& dir, Callback added, QObject* parent)
+  : QObject(parent), dir_(QDir(dir).absolutePath()), added_(added), fd_(-1), notifier_(0)
+{
+  for(auto format: QImageReader::supportedImageFormats())
+    suffixes_ << QString::fromLatin1(format).toLower();
+
+  fd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if(fd_ < 0) return;
+
+  // A file is ready once its writer closes it or it is renamed into place.
+  if(inotify_add_watch(fd_, QFile::encodeName(dir_).constData(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+    ::close(fd_);
+    fd_ = -1;
+    return;
+  }
+
+  notifier_ = new QSocketNotifier(fd_, QSocketNotifier::Read, this);
+  connect(notifier_, &QSocketNotifier::activated,
+          [=] { this -> readEvents(); }
+          );
+}
+
+FolderWatcher::~FolderWatcher()
+{
+  if(fd_ >= 0) ::close(fd_);
+}
+
+bool FolderWatcher::isWatching() const
+{
+  return fd_ >= 0;
+}
+
+void FolderWatcher::readEvents()
+{
+  char buffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+
+  for(;;) {
+    ssize_t size = ::read(fd_, buffer, sizeof(buffer));
+    if(size <= 0) return;
+
+    for(char* p = buffer; p < buffer + size; ) {
+      auto event = reinterpret_cast<const struct inotify_event*>(p);
+      p += sizeof(struct inotify_event) + event -> len;
+
+      if(event -> len == 0 || (event -> mask & IN_ISDIR)) continue;
+
+      QString name = QFile::decodeName(event -> name);
+      if(name.startsWith('.') || !suffixes_.contains(QFileInfo(name).suffix().toLower())) continue;
+
+      added_(dir_ + "/" + name);
+    }
+  }
+}
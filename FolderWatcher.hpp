@@ -0,0 +1,29 @@
+#ifndef FOLDERWATCHER_H
+#define FOLDERWATCHER_H
+#include <QObject>
+#include <QString>
+#include <QSet>
+#include <functional>
+
+class QSocketNotifier;
+
+class FolderWatcher: public QObject
+{
+public:
+  typedef std::function<void(const QString& fileName)> Callback;
+
+  FolderWatcher(const QString& dir, Callback added, QObject* parent = 0);
+  ~FolderWatcher();
+
+  bool isWatching() const;
+
+private:
+  void readEvents();
+
+  QString dir_;
+  Callback added_;
+  QSet<QString> suffixes_;
+  int fd_;
+  QSocketNotifier* notifier_;
+};
+#endif /* FOLDERWATCHER_H */
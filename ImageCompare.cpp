@@ -0,0 +1,191 @@
+#include <QAtomicInteger>
+#include <algorithm>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "ImageCompare.hpp"
+#include "PixelKernels.hpp"
+#include "PixelFormat.hpp"
+#include "Parallel.hpp"
+
+namespace {
+  const int TILE_SHIFT = 4;
+
+  // Changed pixels are drawn as premultiplied red whose opacity grows with
+  // the largest channel difference.
+  inline quint32 heatPixel(int diff) {
+    quint32 a = std::min(diff * 2 + 64, 255);
+    return (a << 24) | (a << 16);
+  }
+
+  // Pixels that only one of the images has count as changed.
+  inline int fillChanged(quint32* heat, uchar* tiles, int from, int to) {
+    for(int x = from; x < to; ++x) {
+      heat[x] = heatPixel(255);
+      tiles[x >> TILE_SHIFT] = 1;
+    }
+    return std::max(to - from, 0);
+  }
+}
+
+int PixelKernels::diffRow(const quint32* a, const quint32* b, quint32* heat, uchar* tiles, int width, int threshold)
+{
+  int changed = 0;
+  int x = 0;
+
+#ifdef __SSE2__
+  const __m128i byteMask = _mm_set1_epi32(0xff);
+  const __m128i limit = _mm_set1_epi32(threshold);
+  const __m128i alphaMax = _mm_set1_epi32(255);
+  const __m128i alphaBase = _mm_set1_epi32(64);
+
+  for(; x + 4 <= width; x += 4) {
+    __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + x));
+    __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + x));
+
+    // Per-byte absolute difference, then the maximum over the four channels
+    // of each pixel ends up in its lowest byte.
+    __m128i d = _mm_or_si128(_mm_subs_epu8(va, vb), _mm_subs_epu8(vb, va));
+    d = _mm_max_epu8(d, _mm_srli_epi32(d, 8));
+    d = _mm_max_epu8(d, _mm_srli_epi32(d, 16));
+    d = _mm_and_si128(d, byteMask);
+
+    __m128i hit = _mm_cmpgt_epi32(d, limit);
+    int bits = _mm_movemask_ps(_mm_castsi128_ps(hit));
+
+    if(bits == 0) {
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(heat + x), _mm_setzero_si128());
+      continue;
+    }
+
+    __m128i alpha = _mm_min_epi16(_mm_add_epi32(_mm_add_epi32(d, d), alphaBase), alphaMax);
+    __m128i px = _mm_or_si128(_mm_slli_epi32(alpha, 24), _mm_slli_epi32(alpha, 16));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(heat + x), _mm_and_si128(px, hit));
+
+    changed += __builtin_popcount(bits);
+    for(int i = 0; i < 4; ++i)
+      if(bits & (1 << i)) tiles[(x + i) >> TILE_SHIFT] = 1;
+  }
+#endif
+
+  return changed + diffRowScalar(a, b, heat, tiles, width, threshold, x);
+}
+
+int PixelKernels::diffRowScalar(const quint32* a, const quint32* b, quint32* heat, uchar* tiles, int width,
+                                int threshold, int from)
+{
+  int changed = 0;
+
+  for(int x = from; x < width; ++x) {
+    quint32 pa = a[x], pb = b[x];
+    int d = 0;
+
+    for(int shift = 0; shift < 32; shift += 8)
+      d = std::max(d, std::abs(int((pa >> shift) & 0xff) - int((pb >> shift) & 0xff)));
+
+    if(d > threshold) {
+      heat[x] = heatPixel(d);
+      tiles[x >> TILE_SHIFT] = 1;
+      ++changed;
+    }
+    else {
+      heat[x] = 0;
+    }
+  }
+
+  return changed;
+}
+
+QVector<QRect> ImageCompare::findRegions(const QVector<uchar>& tiles, int tilesX, int tilesY, const QRect& bounds)
+{
+  QVector<QRect> ret;
+  QVector<uchar> seen(tiles.size(), 0);
+  QVector<int> stack;
+  int tile = 1 << TILE_SHIFT;
+
+  for(int i = 0; i < tiles.size(); ++i) {
+    if(!tiles[i] || seen[i]) continue;
+
+    int minX = tilesX, minY = tilesY, maxX = 0, maxY = 0;
+    stack.push_back(i);
+    seen[i] = 1;
+
+    while(!stack.isEmpty()) {
+      int t = stack.takeLast();
+      int tx = t % tilesX, ty = t / tilesX;
+
+      minX = std::min(minX, tx); maxX = std::max(maxX, tx);
+      minY = std::min(minY, ty); maxY = std::max(maxY, ty);
+
+      for(int dy = -1; dy <= 1; ++dy) {
+        for(int dx = -1; dx <= 1; ++dx) {
+          int nx = tx + dx, ny = ty + dy;
+          if(nx < 0 || ny < 0 || nx >= tilesX || ny >= tilesY) continue;
+
+          int n = ny * tilesX + nx;
+          if(tiles[n] && !seen[n]) {
+            seen[n] = 1;
+            stack.push_back(n);
+          }
+        }
+      }
+    }
+
+    ret << (QRect(minX * tile, minY * tile, (maxX - minX + 1) * tile, (maxY - minY + 1) * tile) & bounds);
+  }
+
+  return ret;
+}
+
+ImageCompare::Result ImageCompare::compare(const QImage& a, const QImage& b, int threshold)
+{
+  QImage ia = PixelFormat::toCanonical(a, "compare");
+  QImage ib = PixelFormat::toCanonical(b, "compare");
+
+  // The heatmap covers both images; only their overlap is diffed.
+  int w = std::min(ia.width(), ib.width());
+  int h = std::min(ia.height(), ib.height());
+  int fullW = std::max(ia.width(), ib.width());
+  int fullH = std::max(ia.height(), ib.height());
+  int tilesX = (fullW + (1 << TILE_SHIFT) - 1) >> TILE_SHIFT;
+  int tilesY = (fullH + (1 << TILE_SHIFT) - 1) >> TILE_SHIFT;
+
+  Result ret;
+  ret.changedPixels = 0;
+  if(fullW <= 0 || fullH <= 0) return ret;
+
+  ret.heatmap = QImage(fullW, fullH, PixelFormat::CANONICAL);
+
+  QVector<uchar> tiles(tilesX * tilesY, 0);
+  QAtomicInteger<qint64> changed(0);
+  uchar* heatBits = ret.heatmap.bits();
+  uchar* tileBits = tiles.data();
+  int heatStride = ret.heatmap.bytesPerLine();
+
+  // Bands are whole tile rows, so no two threads write the same tile.
+  Parallel::forRange(tilesY, [&](int begin, int end) {
+      qint64 local = 0;
+      int last = std::min(end << TILE_SHIFT, fullH);
+      for(int y = begin << TILE_SHIFT; y < last; ++y) {
+        auto heat = reinterpret_cast<quint32*>(heatBits + y * heatStride);
+        uchar* tileRow = tileBits + (y >> TILE_SHIFT) * tilesX;
+        int from = 0;
+
+        if(y < h) {
+          local += PixelKernels::diffRow(reinterpret_cast<const quint32*>(ia.constScanLine(y)),
+                                         reinterpret_cast<const quint32*>(ib.constScanLine(y)),
+                                         heat, tileRow, w, threshold);
+          from = w;
+        }
+        local += fillChanged(heat, tileRow, from, fullW);
+      }
+      changed.fetchAndAddRelaxed(local);
+    }, 4);
+
+  ret.changedPixels = changed.load();
+  ret.regions = findRegions(tiles, tilesX, tilesY, QRect(0, 0, fullW, fullH));
+
+  return ret;
+}
@@ -0,0 +1,21 @@
+#ifndef IMAGECOMPARE_H
+#define IMAGECOMPARE_H
+#include <QImage>
+#include <QVector>
+#include <QRect>
+
+class ImageCompare
+{
+public:
+  struct Result {
+    QImage heatmap;
+    QVector<QRect> regions;
+    qint64 changedPixels;
+  };
+
+  static Result compare(const QImage& a, const QImage& b, int threshold = 0);
+
+private:
+  static QVector<QRect> findRegions(const QVector<uchar>& tiles, int tilesX, int tilesY, const QRect& bounds);
+};
+#endif /* IMAGECOMPARE_H */
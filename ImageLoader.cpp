@@ -0,0 +1,92 @@
+#include <QCoreApplication>
+#include <QThreadPool>
+#include <QRunnable>
+#include <QThread>
+#include <QEvent>
+#include <QImageReader>
+#include <algorithm>
+
+#include "ImageLoader.hpp"
+#include "PixelFormat.hpp"
+
+namespace {
+  const QEvent::Type LOADED_EVENT = QEvent::Type(QEvent::User + 1);
+
+  class LoadedEvent : public QEvent
+  {
+  public:
+    LoadedEvent(quint64 id, const QImage& image): QEvent(LOADED_EVENT), id_(id), image_(image) {
+    }
+
+    quint64 id_;
+    QImage image_;
+  };
+
+  class LoadTask : public QRunnable
+  {
+  public:
+    LoadTask(ImageLoader* loader, quint64 id, const QString& fileName)
+      : loader_(loader), id_(id), fileName_(fileName) {
+    }
+
+    void run() {
+      QImageReader reader(fileName_);
+      QImage image = PixelFormat::toCanonical(reader.read(), "load");
+
+      // Results go back through the event queue of the loader's thread.
+      QCoreApplication::postEvent(loader_, new LoadedEvent(id_, image));
+    }
+
+  private:
+    ImageLoader* loader_;
+    quint64 id_;
+    QString fileName_;
+  };
+}
+
+ImageLoader::ImageLoader(int maxJobs, QObject* parent)
+  : QObject(parent), nextId_(0),
+    maxJobs_(maxJobs > 0 ? maxJobs : std::max(1, QThread::idealThreadCount() / 2))
+{
+}
+
+ImageLoader::~ImageLoader()
+{
+  // Running tasks post to this object.
+  QThreadPool::globalInstance() -> waitForDone();
+}
+
+void ImageLoader::load(const QString& fileName, Callback done)
+{
+  Request request = {nextId_++, fileName, done};
+  queue_.enqueue(request);
+  this -> startNext();
+}
+
+int ImageLoader::pending() const
+{
+  return queue_.size() + running_.size();
+}
+
+void ImageLoader::startNext()
+{
+  // At most maxJobs_ decoded images are in flight, however many files wait.
+  while(!queue_.isEmpty() && running_.size() < maxJobs_) {
+    Request request = queue_.dequeue();
+    running_.insert(request.id, request);
+    QThreadPool::globalInstance() -> start(new LoadTask(this, request.id, request.fileName));
+  }
+}
+
+bool ImageLoader::event(QEvent* event)
+{
+  if(event -> type() != LOADED_EVENT) return QObject::event(event);
+
+  auto loaded = static_cast<LoadedEvent*>(event);
+  Request request = running_.take(loaded -> id_);
+
+  this -> startNext();
+  if(request.done) request.done(request.fileName, loaded -> image_);
+
+  return true;
+}
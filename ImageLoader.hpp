@@ -0,0 +1,37 @@
+#ifndef IMAGELOADER_H
+#define IMAGELOADER_H
+#include <QObject>
+#include <QImage>
+#include <QQueue>
+#include <QHash>
+#include <functional>
+
+class ImageLoader: public QObject
+{
+public:
+  typedef std::function<void(const QString& fileName, const QImage& image)> Callback;
+
+  ImageLoader(int maxJobs = 0, QObject* parent = 0);
+  ~ImageLoader();
+
+  void load(const QString& fileName, Callback done);
+  int pending() const;
+
+protected:
+  bool event(QEvent* event);
+
+private:
+  void startNext();
+
+  struct Request {
+    quint64 id;
+    QString fileName;
+    Callback done;
+  };
+
+  QQueue<Request> queue_;
+  QHash<quint64, Request> running_;
+  quint64 nextId_;
+  int maxJobs_;
+};
+#endif /* IMAGELOADER_H */
@@ -0,0 +1,125 @@
+#include <QGraphicsItem>
+#include <QPen>
+#include <QBrush>
+#include <QFont>
+
+#include "ItemSerializer.hpp"
+#include "Qoi.hpp"
+#include "PixelFormat.hpp"
+#include "CachedTextItem.hpp"
+
+bool ItemSerializer::write(QDataStream& out, const QGraphicsItem* item)
+{
+  switch(item -> type()) {
+  case QGraphicsPathItem::Type: {
+    auto path = static_cast<const QGraphicsPathItem*>(item);
+    out << qint32(item -> type()) << item -> pos() << item -> zValue();
+    out << path -> pen() << path -> brush() << path -> path();
+    break;
+  }
+  case QGraphicsLineItem::Type: {
+    auto line = static_cast<const QGraphicsLineItem*>(item);
+    out << qint32(item -> type()) << item -> pos() << item -> zValue();
+    out << line -> pen() << line -> line();
+    break;
+  }
+  case QGraphicsRectItem::Type: {
+    auto rect = static_cast<const QGraphicsRectItem*>(item);
+    out << qint32(item -> type()) << item -> pos() << item -> zValue();
+    out << rect -> pen() << rect -> brush() << rect -> rect();
+    break;
+  }
+  case QGraphicsPixmapItem::Type: {
+    auto pixmap = static_cast<const QGraphicsPixmapItem*>(item);
+    out << qint32(item -> type()) << item -> pos() << item -> zValue();
+    out << Qoi::encode(PixelFormat::fromPixmap(pixmap -> pixmap(), "session"));
+    break;
+  }
+  case QGraphicsSimpleTextItem::Type: {
+    auto text = static_cast<const QGraphicsSimpleTextItem*>(item);
+    out << qint32(item -> type()) << item -> pos() << item -> zValue();
+    out << text -> pen() << text -> brush() << text -> font() << text -> text();
+    break;
+  }
+  default:
+    return false;
+  }
+
+  return out.status() == QDataStream::Ok;
+}
+
+QGraphicsItem* ItemSerializer::read(QDataStream& in)
+{
+  qint32 type;
+  QPointF pos;
+  qreal z;
+  QPen pen;
+  QBrush brush;
+  QGraphicsItem* ret = 0;
+
+  in >> type >> pos >> z;
+  if(in.status() != QDataStream::Ok) return 0;
+
+  switch(type) {
+  case QGraphicsPathItem::Type: {
+    QPainterPath path;
+    in >> pen >> brush >> path;
+
+    auto item = new QGraphicsPathItem(path);
+    item -> setPen(pen);
+    item -> setBrush(brush);
+    ret = item;
+    break;
+  }
+  case QGraphicsLineItem::Type: {
+    QLineF line;
+    in >> pen >> line;
+
+    auto item = new QGraphicsLineItem(line);
+    item -> setPen(pen);
+    ret = item;
+    break;
+  }
+  case QGraphicsRectItem::Type: {
+    QRectF rect;
+    in >> pen >> brush >> rect;
+
+    auto item = new QGraphicsRectItem(rect);
+    item -> setPen(pen);
+    item -> setBrush(brush);
+    ret = item;
+    break;
+  }
+  case QGraphicsPixmapItem::Type: {
+    QByteArray data;
+    in >> data;
+
+    ret = new QGraphicsPixmapItem(PixelFormat::toPixmap(Qoi::decode(data), "restore"));
+    break;
+  }
+  case QGraphicsSimpleTextItem::Type: {
+    QFont font;
+    QString text;
+    in >> pen >> brush >> font >> text;
+
+    auto item = new CachedTextItem(text);
+    item -> setPen(pen);
+    item -> setBrush(brush);
+    item -> setFont(font);
+    ret = item;
+    break;
+  }
+  default:
+    in.setStatus(QDataStream::ReadCorruptData);
+    return 0;
+  }
+
+  if(in.status() != QDataStream::Ok) {
+    delete ret;
+    return 0;
+  }
+
+  ret -> setPos(pos);
+  ret -> setZValue(z);
+  return ret;
+}
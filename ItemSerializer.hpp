@@ -0,0 +1,12 @@
+#ifndef ITEMSERIALIZER_H
+#define ITEMSERIALIZER_H
+#include <QDataStream>
+
+class QGraphicsItem;
+class ItemSerializer
+{
+public:
+  static bool write(QDataStream& out, const QGraphicsItem* item);
+  static QGraphicsItem* read(QDataStream& in);
+};
+#endif /* ITEMSERIALIZER_H */
@@ -0,0 +1,166 @@
+#include <QFile>
+#include <QDataStream>
+#include <QThreadPool>
+#include <QRunnable>
+
+#include "Journal.hpp"
+
+namespace {
+  // size, checksum, then the body of seq, op and payload.
+  const int RECORD_HEADER_SIZE = 6;
+  const int BODY_HEADER_SIZE = 9;
+}
+
+class JournalWriter : public QRunnable
+{
+public:
+  JournalWriter(Journal* journal): journal_(journal) {
+  }
+
+  void run() {
+    journal_ -> writeLoop();
+  }
+
+private:
+  Journal* journal_;
+};
+
+Journal::Journal(QObject* parent)
+  : QObject(parent), seq_(0), size_(0), truncate_(false), running_(false)
+{
+}
+
+Journal::~Journal()
+{
+  this -> close();
+}
+
+void Journal::open(const QString& path, quint64 seq)
+{
+  this -> close();
+
+  QMutexLocker lock(&mutex_);
+  path_ = path;
+  seq_ = seq;
+  size_ = QFile(path).size();
+}
+
+void Journal::close()
+{
+  QMutexLocker lock(&mutex_);
+  while(running_) idle_.wait(&mutex_);
+  path_.clear();
+}
+
+bool Journal::isOpen() const
+{
+  return !path_.isEmpty();
+}
+
+void Journal::append(quint8 op, const QByteArray& payload)
+{
+  if(path_.isEmpty()) return;
+
+  QByteArray body;
+  QDataStream out(&body, QIODevice::WriteOnly);
+  out << quint64(++seq_) << op;
+  out.writeRawData(payload.constData(), payload.size());
+
+  QByteArray record;
+  QDataStream header(&record, QIODevice::WriteOnly);
+  header << quint32(body.size()) << qChecksum(body.constData(), body.size());
+  record += body;
+
+  QMutexLocker lock(&mutex_);
+  pending_ += record;
+  size_ += record.size();
+
+  // Records appended while a write is running go out with the next batch.
+  if(!running_) {
+    running_ = true;
+    QThreadPool::globalInstance() -> start(new JournalWriter(this));
+  }
+}
+
+void Journal::truncate()
+{
+  QMutexLocker lock(&mutex_);
+  if(path_.isEmpty()) return;
+
+  // Everything appended so far is covered by the checkpoint.
+  pending_.clear();
+  truncate_ = true;
+  size_ = 0;
+
+  if(!running_) {
+    running_ = true;
+    QThreadPool::globalInstance() -> start(new JournalWriter(this));
+  }
+}
+
+quint64 Journal::sequence() const
+{
+  return seq_;
+}
+
+qint64 Journal::size() const
+{
+  return size_;
+}
+
+void Journal::writeLoop()
+{
+  for(;;) {
+    QMutexLocker lock(&mutex_);
+    if(pending_.isEmpty() && !truncate_) {
+      running_ = false;
+      idle_.wakeAll();
+      return;
+    }
+
+    QByteArray data;
+    data.swap(pending_);
+    bool truncate = truncate_;
+    truncate_ = false;
+    QString path = path_;
+    lock.unlock();
+
+    QFile file(path);
+    if(file.open(truncate ? QIODevice::WriteOnly | QIODevice::Truncate :
+                 QIODevice::WriteOnly | QIODevice::Append))
+      file.write(data);
+  }
+}
+
+QVector<Journal::Record> Journal::read(const QString& path)
+{
+  QVector<Record> ret;
+  QFile file(path);
+  if(!file.open(QIODevice::ReadOnly)) return ret;
+
+  QByteArray data = file.readAll();
+  int pos = 0;
+
+  // A torn or corrupt record ends the journal.
+  while(pos + RECORD_HEADER_SIZE <= data.size()) {
+    quint32 size;
+    quint16 checksum;
+    QDataStream header(data.mid(pos, RECORD_HEADER_SIZE));
+    header >> size >> checksum;
+
+    if(size < quint32(BODY_HEADER_SIZE) || pos + RECORD_HEADER_SIZE + qint64(size) > data.size()) break;
+
+    const char* body = data.constData() + pos + RECORD_HEADER_SIZE;
+    if(qChecksum(body, size) != checksum) break;
+
+    Record record;
+    QDataStream in(QByteArray::fromRawData(body, BODY_HEADER_SIZE));
+    in >> record.seq >> record.op;
+    record.payload = QByteArray(body + BODY_HEADER_SIZE, size - BODY_HEADER_SIZE);
+    ret << record;
+
+    pos += RECORD_HEADER_SIZE + size;
+  }
+
+  return ret;
+}
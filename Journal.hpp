@@ -0,0 +1,51 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+#include <QObject>
+#include <QByteArray>
+#include <QVector>
+#include <QMutex>
+#include <QWaitCondition>
+
+class Journal: public QObject
+{
+public:
+  enum Op {
+    ADD = 1,
+    REMOVE = 2,
+    TRANSFORM = 3,
+  };
+
+  struct Record {
+    quint64 seq;
+    quint8 op;
+    QByteArray payload;
+  };
+
+  Journal(QObject* parent = 0);
+  ~Journal();
+
+  void open(const QString& path, quint64 seq);
+  void close();
+  bool isOpen() const;
+  void append(quint8 op, const QByteArray& payload);
+  void truncate();
+  quint64 sequence() const;
+  qint64 size() const;
+
+  static QVector<Record> read(const QString& path);
+
+private:
+  friend class JournalWriter;
+  void writeLoop();
+
+  QString path_;
+  quint64 seq_;
+  qint64 size_;
+
+  QMutex mutex_;
+  QWaitCondition idle_;
+  QByteArray pending_;
+  bool truncate_;
+  bool running_;
+};
+#endif /* JOURNAL_H */
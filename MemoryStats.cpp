@@ -0,0 +1,131 @@
+#include <QCoreApplication>
+#include <QSocketNotifier>
+#include <QGraphicsPixmapItem>
+#include <QGraphicsPathItem>
+#include <QGraphicsSimpleTextItem>
+#include <QGraphicsLineItem>
+#include <QGraphicsRectItem>
+#include <signal.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "MemoryStats.hpp"
+#include "CachedTextItem.hpp"
+
+namespace {
+  int signalFds[2] = {-1, -1};
+
+  void signalHandler(int)
+  {
+    char c = 1;
+    ssize_t ret = ::write(signalFds[0], &c, 1);
+    (void)ret;
+  }
+
+  QString category(const QGraphicsItem* item)
+  {
+    switch(item -> type()) {
+    case QGraphicsPixmapItem::Type: return "Pixmap items";
+    case QGraphicsPathItem::Type: return "Path items";
+    case QGraphicsSimpleTextItem::Type: return "Text items";
+    default: return "Shape items";
+    }
+  }
+}
+
+void MemoryStats::add(const QString& name, qint64 bytes, int count)
+{
+  for(auto& entry: entries_) {
+    if(entry.name == name) {
+      entry.count += count;
+      entry.bytes += bytes;
+      return;
+    }
+  }
+
+  entries_ << Entry{name, count, bytes};
+}
+
+void MemoryStats::addItem(const QString& prefix, const QGraphicsItem* item)
+{
+  this -> add(prefix + category(item), itemBytes(item));
+}
+
+qint64 MemoryStats::total() const
+{
+  qint64 ret = 0;
+  for(auto& entry: entries_) ret += entry.bytes;
+  return ret;
+}
+
+QString MemoryStats::report() const
+{
+  QString ret;
+
+  for(auto& entry: entries_) {
+    ret += entry.name + ": " + kib(entry.bytes);
+    if(entry.count != 1) ret += " (" + QString::number(entry.count) + ")";
+    ret += "\n";
+  }
+  ret += "Total: " + kib(this -> total()) + "\n";
+
+  return ret;
+}
+
+qint64 MemoryStats::imageBytes(const QImage& image)
+{
+  return qint64(image.bytesPerLine()) * image.height();
+}
+
+qint64 MemoryStats::pixmapBytes(const QPixmap& pixmap)
+{
+  return qint64(pixmap.width()) * pixmap.height() * pixmap.depth() / 8;
+}
+
+qint64 MemoryStats::itemBytes(const QGraphicsItem* item)
+{
+  // Estimates of the heap held by the item itself, not by shared data such
+  // as fonts or pens.
+  if(auto pixmapItem = qgraphicsitem_cast<const QGraphicsPixmapItem*>(item))
+    return sizeof(QGraphicsPixmapItem) + pixmapBytes(pixmapItem -> pixmap());
+
+  if(auto pathItem = qgraphicsitem_cast<const QGraphicsPathItem*>(item))
+    return sizeof(QGraphicsPathItem) + pathItem -> path().elementCount() * sizeof(QPainterPath::Element);
+
+  if(auto textItem = dynamic_cast<const CachedTextItem*>(item))
+    return sizeof(CachedTextItem) + textItem -> text().size() * sizeof(QChar) + textItem -> cacheBytes();
+
+  if(auto textItem = qgraphicsitem_cast<const QGraphicsSimpleTextItem*>(item))
+    return sizeof(QGraphicsSimpleTextItem) + textItem -> text().size() * sizeof(QChar);
+
+  if(qgraphicsitem_cast<const QGraphicsLineItem*>(item) != 0) return sizeof(QGraphicsLineItem);
+  if(qgraphicsitem_cast<const QGraphicsRectItem*>(item) != 0) return sizeof(QGraphicsRectItem);
+
+  return sizeof(QGraphicsItem);
+}
+
+QString MemoryStats::kib(qint64 bytes)
+{
+  return QString::number(bytes / 1024.0, 'f', 1) + " KiB";
+}
+
+bool MemoryStats::dumpOnSignal(int signum, std::function<void()> dump)
+{
+  // The handler only wakes the event loop; the dump runs on the GUI thread.
+  if(signalFds[0] < 0 && ::socketpair(AF_UNIX, SOCK_STREAM, 0, signalFds) != 0) return false;
+
+  auto notifier = new QSocketNotifier(signalFds[1], QSocketNotifier::Read, QCoreApplication::instance());
+  QObject::connect(notifier, &QSocketNotifier::activated,
+                   [=] {
+                     char c;
+                     if(::read(signalFds[1], &c, 1) == 1) dump();
+                   }
+                   );
+
+  struct sigaction action;
+  action.sa_handler = signalHandler;
+  sigemptyset(&action.sa_mask);
+  action.sa_flags = SA_RESTART;
+
+  return ::sigaction(signum, &action, 0) == 0;
+}
@@ -0,0 +1,34 @@
+#ifndef MEMORYSTATS_H
+#define MEMORYSTATS_H
+#include <QString>
+#include <QVector>
+#include <QImage>
+#include <QPixmap>
+#include <functional>
+
+class QGraphicsItem;
+
+class MemoryStats
+{
+public:
+  void add(const QString& name, qint64 bytes, int count = 1);
+  void addItem(const QString& prefix, const QGraphicsItem* item);
+  qint64 total() const;
+  QString report() const;
+
+  static qint64 imageBytes(const QImage& image);
+  static qint64 pixmapBytes(const QPixmap& pixmap);
+  static qint64 itemBytes(const QGraphicsItem* item);
+  static QString kib(qint64 bytes);
+
+  static bool dumpOnSignal(int signum, std::function<void()> dump);
+
+private:
+  struct Entry {
+    QString name;
+    int count;
+    qint64 bytes;
+  };
+  QVector<Entry> entries_;
+};
+#endif /* MEMORYSTATS_H */
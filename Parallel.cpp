@@ -0,0 +1,50 @@
+#include <QThreadPool>
+#include <QRunnable>
+#include <QSemaphore>
+#include <QThread>
+#include <algorithm>
+
+#include "Parallel.hpp"
+
+namespace {
+  class RangeTask : public QRunnable
+  {
+  public:
+    RangeTask(const std::function<void(int, int)>& func, int begin, int end, QSemaphore* done)
+      : func_(func), begin_(begin), end_(end), done_(done) {
+    }
+
+    void run() {
+      func_(begin_, end_);
+      done_ -> release();
+    }
+
+  private:
+    const std::function<void(int, int)>& func_;
+    int begin_, end_;
+    QSemaphore* done_;
+  };
+}
+
+void Parallel::forRange(int count, const std::function<void(int, int)>& func, int minChunk)
+{
+  int chunks = std::min(QThread::idealThreadCount(), count / std::max(minChunk, 1));
+
+  if(chunks <= 1) {
+    if(count > 0) func(0, count);
+    return;
+  }
+
+  QSemaphore done;
+  int step = (count + chunks - 1) / chunks;
+
+  // The calling thread takes the first chunk itself.
+  int started = 0;
+  for(int begin = step; begin < count; begin += step) {
+    QThreadPool::globalInstance() -> start(new RangeTask(func, begin, std::min(begin + step, count), &done));
+    ++started;
+  }
+  func(0, std::min(step, count));
+
+  done.acquire(started);
+}
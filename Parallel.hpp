@@ -0,0 +1,10 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+#include <functional>
+
+class Parallel
+{
+public:
+  static void forRange(int count, const std::function<void(int, int)>& func, int minChunk = 1);
+};
+#endif /* PARALLEL_H */
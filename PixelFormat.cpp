@@ -0,0 +1,62 @@
+#include "PixelFormat.hpp"
+
+QMap<QString, int> PixelFormat::conversions_;
+QMutex PixelFormat::mutex_;
+
+void PixelFormat::count(const char* site)
+{
+  // Images are also converted on pool threads, e.g. by ImageLoader.
+  QMutexLocker lock(&mutex_);
+  ++conversions_[site];
+}
+
+QImage PixelFormat::toCanonical(const QImage& image, const char* site)
+{
+  if(image.isNull() || image.format() == CANONICAL) return image;
+
+  count(site);
+  return image.convertToFormat(CANONICAL);
+}
+
+QImage PixelFormat::fromPixmap(const QPixmap& pixmap, const char* site)
+{
+  // Raster pixmaps hand out their backing image, so this is free as long
+  // as the pixmap was created from a canonical image.
+  return toCanonical(pixmap.toImage(), site);
+}
+
+QPixmap PixelFormat::toPixmap(QImage image, const char* site)
+{
+  image = toCanonical(image, site);
+
+  // Without NoOpaqueDetection the raster backend silently turns opaque
+  // images, i.e. every screenshot, into RGB32.
+  return QPixmap::fromImage(std::move(image), Qt::NoOpaqueDetection);
+}
+
+QImage PixelFormat::forExport(QImage image)
+{
+  if(image.format() != CANONICAL) return image;
+
+  for(int y = 0; y < image.height(); ++y) {
+    auto line = reinterpret_cast<const QRgb*>(image.constScanLine(y));
+    for(int x = 0; x < image.width(); ++x)
+      if(qAlpha(line[x]) != 255) return image;
+  }
+
+  // Opaque premultiplied pixels are already RGB32, which keeps the alpha
+  // channel out of saved files and the clipboard.
+  image.reinterpretAsFormat(QImage::Format_RGB32);
+  return image;
+}
+
+QString PixelFormat::report()
+{
+  QMutexLocker lock(&mutex_);
+  QString ret;
+
+  for(auto it = conversions_.constBegin(); it != conversions_.constEnd(); ++it)
+    ret += it.key() + ": " + QString::number(it.value()) + "\n";
+
+  return ret;
+}
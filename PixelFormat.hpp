@@ -0,0 +1,26 @@
+#ifndef PIXELFORMAT_H
+#define PIXELFORMAT_H
+#include <QImage>
+#include <QPixmap>
+#include <QMap>
+#include <QMutex>
+
+class PixelFormat
+{
+public:
+  static const QImage::Format CANONICAL = QImage::Format_ARGB32_Premultiplied;
+
+  static QImage toCanonical(const QImage& image, const char* site);
+  static QImage fromPixmap(const QPixmap& pixmap, const char* site);
+  static QPixmap toPixmap(QImage image, const char* site);
+  static QImage forExport(QImage image);
+
+  static QString report();
+
+private:
+  static void count(const char* site);
+
+  static QMap<QString, int> conversions_;
+  static QMutex mutex_;
+};
+#endif /* PIXELFORMAT_H */
@@ -0,0 +1,41 @@
+#ifndef PIXELKERNELS_H
+#define PIXELKERNELS_H
+#include <QtGlobal>
+
+// The SSE2 inner loops of the image modules, each next to the scalar version
+// it must match. The scalar versions also finish the tails, and are what runs
+// without SSE2. Each kernel is defined in the module that uses it.
+class PixelKernels
+{
+public:
+  // Resample: one output pixel from taps source pixels starting at begin[x],
+  // with weights in Q14 summing to one.
+  static void resampleRow(const quint32* src, quint32* dst, int width,
+                          const int* begin, const qint16* weights, int taps);
+  static void resampleRowScalar(const quint32* src, quint32* dst, int width,
+                                const int* begin, const qint16* weights, int taps);
+  static void resampleColumns(const quint32* const* rows, quint32* dst, int width,
+                              const qint16* weights, int taps);
+  static void resampleColumnsScalar(const quint32* const* rows, quint32* dst, int width,
+                                    const qint16* weights, int taps, int from = 0);
+
+  // ImageCompare: heatmap pixels and changed 16-pixel tiles of one row;
+  // returns the number of pixels differing by more than threshold.
+  static int diffRow(const quint32* a, const quint32* b, quint32* heat, uchar* tiles, int width, int threshold);
+  static int diffRowScalar(const quint32* a, const quint32* b, quint32* heat, uchar* tiles, int width,
+                           int threshold, int from = 0);
+
+  // Quantize: index of the palette entry nearest to a straight color; ties
+  // go to the lowest index.
+  static int nearestColor(const qint16* r, const qint16* g, const qint16* b, int count, int pr, int pg, int pb);
+  static int nearestColorScalar(const qint16* r, const qint16* g, const qint16* b, int count,
+                                int pr, int pg, int pb);
+
+  // AutoTrim: first or last pixel with a channel further than tolerance from
+  // color, or -1.
+  static int firstMismatch(const quint32* row, int width, quint32 color, int tolerance);
+  static int firstMismatchScalar(const quint32* row, int width, quint32 color, int tolerance, int from = 0);
+  static int lastMismatch(const quint32* row, int width, quint32 color, int tolerance);
+  static int lastMismatchScalar(const quint32* row, int width, quint32 color, int tolerance);
+};
+#endif /* PIXELKERNELS_H */
@@ -0,0 +1,210 @@
+#include <limits>
+
+#include "Qoi.hpp"
+
+namespace {
+  const int HEADER_SIZE = 14;
+  const int PADDING_SIZE = 8;
+  const int MAX_SIZE = 65535;
+
+  enum {
+    OP_INDEX = 0x00,
+    OP_DIFF  = 0x40,
+    OP_LUMA  = 0x80,
+    OP_RUN   = 0xc0,
+    OP_RGB   = 0xfe,
+    OP_RGBA  = 0xff,
+    OP_MASK  = 0xc0,
+  };
+
+  inline int hash(QRgb px) {
+    return (qRed(px) * 3 + qGreen(px) * 5 + qBlue(px) * 7 + qAlpha(px) * 11) % 64;
+  }
+
+  inline void write32(uchar* p, quint32 v) {
+    p[0] = v >> 24; p[1] = v >> 16; p[2] = v >> 8; p[3] = v;
+  }
+
+  inline quint32 read32(const uchar* p) {
+    return (quint32(p[0]) << 24) | (quint32(p[1]) << 16) | (quint32(p[2]) << 8) | p[3];
+  }
+}
+
+QByteArray Qoi::encode(const QImage& image)
+{
+  QImage img = image;
+  bool alpha = img.hasAlphaChannel();
+
+  if(img.format() != QImage::Format_RGB32 && img.format() != QImage::Format_ARGB32 &&
+     img.format() != QImage::Format_ARGB32_Premultiplied)
+    img = img.convertToFormat(alpha ? QImage::Format_ARGB32_Premultiplied : QImage::Format_RGB32);
+
+  bool premultiplied = (img.format() == QImage::Format_ARGB32_Premultiplied);
+
+  int w = img.width();
+  int h = img.height();
+  int channels = alpha ? 4 : 3;
+
+  // Images decode() would refuse, or whose worst case encoding does not fit
+  // in a QByteArray, are not encoded at all.
+  QByteArray ret;
+  qint64 maxBytes = HEADER_SIZE + qint64(w) * h * (channels + 1) + PADDING_SIZE;
+  if(img.isNull() || w > MAX_SIZE || h > MAX_SIZE || maxBytes > std::numeric_limits<int>::max()) return ret;
+
+  ret.resize(maxBytes);
+  uchar* out = reinterpret_cast<uchar*>(ret.data());
+  uchar* p = out;
+
+  *p++ = 'q'; *p++ = 'o'; *p++ = 'i'; *p++ = 'f';
+  write32(p, w); p += 4;
+  write32(p, h); p += 4;
+  *p++ = channels;
+  *p++ = 0;
+
+  QRgb index[64] = {0};
+  QRgb prev = qRgba(0, 0, 0, 255);
+  QRgb mask = alpha ? 0 : 0xff000000;
+  int run = 0;
+
+  for(int y = 0; y < h; ++y) {
+    const QRgb* row = reinterpret_cast<const QRgb*>(img.constScanLine(y));
+    bool lastRow = (y == h - 1);
+
+    for(int x = 0; x < w; ++x) {
+      QRgb px = row[x] | mask;
+      if(premultiplied && qAlpha(px) != 255) px = qUnpremultiply(px);
+
+      if(px == prev) {
+        ++run;
+        if(run == 62 || (lastRow && x == w - 1)) {
+          *p++ = OP_RUN | (run - 1);
+          run = 0;
+        }
+        continue;
+      }
+
+      if(run > 0) {
+        *p++ = OP_RUN | (run - 1);
+        run = 0;
+      }
+
+      int idx = hash(px);
+      if(index[idx] == px) {
+        *p++ = OP_INDEX | idx;
+      }
+      else {
+        index[idx] = px;
+
+        if(qAlpha(px) == qAlpha(prev)) {
+          signed char vr = qRed(px) - qRed(prev);
+          signed char vg = qGreen(px) - qGreen(prev);
+          signed char vb = qBlue(px) - qBlue(prev);
+          signed char vgr = vr - vg;
+          signed char vgb = vb - vg;
+
+          if(vr > -3 && vr < 2 && vg > -3 && vg < 2 && vb > -3 && vb < 2) {
+            *p++ = OP_DIFF | (vr + 2) << 4 | (vg + 2) << 2 | (vb + 2);
+          }
+          else if(vgr > -9 && vgr < 8 && vg > -33 && vg < 32 && vgb > -9 && vgb < 8) {
+            *p++ = OP_LUMA | (vg + 32);
+            *p++ = (vgr + 8) << 4 | (vgb + 8);
+          }
+          else {
+            *p++ = OP_RGB;
+            *p++ = qRed(px); *p++ = qGreen(px); *p++ = qBlue(px);
+          }
+        }
+        else {
+          *p++ = OP_RGBA;
+          *p++ = qRed(px); *p++ = qGreen(px); *p++ = qBlue(px); *p++ = qAlpha(px);
+        }
+      }
+      prev = px;
+    }
+  }
+
+  for(int i = 0; i < PADDING_SIZE - 1; ++i) *p++ = 0;
+  *p++ = 1;
+
+  ret.resize(p - out);
+  return ret;
+}
+
+QImage Qoi::decode(const QByteArray& data)
+{
+  return decode(data.constData(), data.size());
+}
+
+QImage Qoi::decode(const char* data, int size)
+{
+  const uchar* bytes = reinterpret_cast<const uchar*>(data);
+
+  if(size < HEADER_SIZE + PADDING_SIZE) return QImage();
+  if(bytes[0] != 'q' || bytes[1] != 'o' || bytes[2] != 'i' || bytes[3] != 'f') return QImage();
+
+  quint32 w = read32(bytes + 4);
+  quint32 h = read32(bytes + 8);
+  int channels = bytes[12];
+
+  if(w == 0 || h == 0 || w > MAX_SIZE || h > MAX_SIZE) return QImage();
+  if(channels != 3 && channels != 4) return QImage();
+
+  QImage img(w, h, QImage::Format_ARGB32_Premultiplied);
+  if(img.isNull()) return img;
+
+  QRgb index[64] = {0};
+  QRgb px = qRgba(0, 0, 0, 255);
+  int p = HEADER_SIZE;
+  int end = size - PADDING_SIZE;
+  int run = 0;
+
+  for(quint32 y = 0; y < h; ++y) {
+    QRgb* row = reinterpret_cast<QRgb*>(img.scanLine(y));
+
+    for(quint32 x = 0; x < w; ++x) {
+      if(run > 0) {
+        --run;
+      }
+      else if(p < end) {
+        int b1 = bytes[p++];
+
+        if(b1 == OP_RGB) {
+          if(p + 3 > end) return QImage();
+          px = qRgba(bytes[p], bytes[p + 1], bytes[p + 2], qAlpha(px));
+          p += 3;
+        }
+        else if(b1 == OP_RGBA) {
+          if(p + 4 > end) return QImage();
+          px = qRgba(bytes[p], bytes[p + 1], bytes[p + 2], bytes[p + 3]);
+          p += 4;
+        }
+        else if((b1 & OP_MASK) == OP_INDEX) {
+          px = index[b1];
+        }
+        else if((b1 & OP_MASK) == OP_DIFF) {
+          px = qRgba((qRed(px) + ((b1 >> 4) & 0x03) - 2) & 0xff,
+                     (qGreen(px) + ((b1 >> 2) & 0x03) - 2) & 0xff,
+                     (qBlue(px) + (b1 & 0x03) - 2) & 0xff,
+                     qAlpha(px));
+        }
+        else if((b1 & OP_MASK) == OP_LUMA) {
+          if(p + 1 > end) return QImage();
+          int b2 = bytes[p++];
+          int vg = (b1 & 0x3f) - 32;
+          px = qRgba((qRed(px) + vg - 8 + ((b2 >> 4) & 0x0f)) & 0xff,
+                     (qGreen(px) + vg) & 0xff,
+                     (qBlue(px) + vg - 8 + (b2 & 0x0f)) & 0xff,
+                     qAlpha(px));
+        }
+        else {
+          run = b1 & 0x3f;
+        }
+
+        index[hash(px)] = px;
+      }
+      row[x] = (qAlpha(px) == 255) ? px : qPremultiply(px);
+    }
+  }
+
+  return img;
+}
@@ -0,0 +1,13 @@
+#ifndef QOI_H
+#define QOI_H
+#include <QByteArray>
+#include <QImage>
+
+class Qoi
+{
+public:
+  static QByteArray encode(const QImage& image);
+  static QImage decode(const char* data, int size);
+  static QImage decode(const QByteArray& data);
+};
+#endif /* QOI_H */
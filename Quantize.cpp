@@ -0,0 +1,313 @@
+#include <algorithm>
+#include <climits>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "Quantize.hpp"
+#include "PixelKernels.hpp"
+#include "PixelFormat.hpp"
+
+namespace {
+  const int TRANSPARENT_THRESHOLD = 128;
+
+  struct Box {
+    int lo[3], hi[3];
+    qint64 count;
+  };
+
+  inline QRgb straight(QRgb px) {
+    return (qAlpha(px) == 255) ? px : qUnpremultiply(px);
+  }
+
+  inline int distance(int r, int g, int b, int pr, int pg, int pb) {
+    return (r - pr) * (r - pr) + (g - pg) * (g - pg) + (b - pb) * (b - pb);
+  }
+}
+
+QImage Quantize::exact(const QImage& image, int maxColors)
+{
+  QImage src = PixelFormat::toCanonical(image, "quantize");
+  const int slots = 1024;
+  QRgb keys[slots];
+  int values[slots];
+  std::fill(values, values + slots, -1);
+
+  QVector<QRgb> palette;
+  QImage ret(src.size(), QImage::Format_Indexed8);
+  QRgb lastPx = 0;
+  int lastIndex = -1;
+
+  for(int y = 0; y < src.height(); ++y) {
+    auto in = reinterpret_cast<const QRgb*>(src.constScanLine(y));
+    uchar* out = ret.scanLine(y);
+
+    for(int x = 0; x < src.width(); ++x) {
+      QRgb px = in[x];
+
+      // Runs of one color are the common case in UI captures.
+      if(px == lastPx && lastIndex >= 0) {
+        out[x] = lastIndex;
+        continue;
+      }
+
+      int slot = ((px * 2654435761u) >> 22) & (slots - 1);
+      while(values[slot] >= 0 && keys[slot] != px) slot = (slot + 1) & (slots - 1);
+
+      if(values[slot] < 0) {
+        if(palette.size() >= maxColors) return QImage();
+
+        keys[slot] = px;
+        values[slot] = palette.size();
+        palette << straight(px);
+      }
+
+      lastPx = px;
+      lastIndex = values[slot];
+      out[x] = lastIndex;
+    }
+  }
+
+  ret.setColorTable(palette);
+  return ret;
+}
+
+QVector<QRgb> Quantize::medianCut(const QImage& image, int colors)
+{
+  // Histogram over 5 bits per channel.
+  QVector<qint64> count(32768, 0), sumR(32768, 0), sumG(32768, 0), sumB(32768, 0);
+
+  for(int y = 0; y < image.height(); ++y) {
+    auto in = reinterpret_cast<const QRgb*>(image.constScanLine(y));
+
+    for(int x = 0; x < image.width(); ++x) {
+      if(qAlpha(in[x]) < TRANSPARENT_THRESHOLD) continue;
+
+      QRgb px = straight(in[x]);
+      int bin = ((qRed(px) >> 3) << 10) | ((qGreen(px) >> 3) << 5) | (qBlue(px) >> 3);
+      ++count[bin];
+      sumR[bin] += qRed(px);
+      sumG[bin] += qGreen(px);
+      sumB[bin] += qBlue(px);
+    }
+  }
+
+  struct Local {
+    static int bin(int r, int g, int b) { return (r << 10) | (g << 5) | b; }
+  };
+
+  QVector<Box> boxes;
+  Box all = {{0, 0, 0}, {31, 31, 31}, 0};
+  for(auto c: count) all.count += c;
+  if(all.count == 0) return QVector<QRgb>();
+  boxes << all;
+
+  while(boxes.size() < colors) {
+    // Split the most populated box that still spans more than one bin.
+    int target = -1;
+    for(int i = 0; i < boxes.size(); ++i) {
+      auto& box = boxes[i];
+      if(box.lo[0] == box.hi[0] && box.lo[1] == box.hi[1] && box.lo[2] == box.hi[2]) continue;
+      if(target < 0 || box.count > boxes[target].count) target = i;
+    }
+    if(target < 0) break;
+
+    Box box = boxes[target];
+    int axis = 0;
+    for(int a = 1; a < 3; ++a)
+      if(box.hi[a] - box.lo[a] > box.hi[axis] - box.lo[axis]) axis = a;
+
+    QVector<qint64> slice(32, 0);
+    for(int r = box.lo[0]; r <= box.hi[0]; ++r)
+      for(int g = box.lo[1]; g <= box.hi[1]; ++g)
+        for(int b = box.lo[2]; b <= box.hi[2]; ++b) {
+          int v[3] = {r, g, b};
+          slice[v[axis]] += count[Local::bin(r, g, b)];
+        }
+
+    qint64 acc = 0;
+    int cut = box.lo[axis];
+    for(; cut < box.hi[axis]; ++cut) {
+      acc += slice[cut];
+      if(acc * 2 >= box.count) break;
+    }
+
+    Box left = box, right = box;
+    left.hi[axis] = cut;
+    right.lo[axis] = cut + 1;
+    left.count = 0;
+    for(int i = left.lo[axis]; i <= left.hi[axis]; ++i) left.count += slice[i];
+    right.count = box.count - left.count;
+
+    // An empty half only narrows the box instead of taking a palette slot.
+    if(left.count == 0) boxes[target] = right;
+    else if(right.count == 0) boxes[target] = left;
+    else {
+      boxes[target] = left;
+      boxes << right;
+    }
+  }
+
+  QVector<QRgb> palette;
+  for(auto& box: boxes) {
+    qint64 n = 0, r = 0, g = 0, b = 0;
+    for(int ir = box.lo[0]; ir <= box.hi[0]; ++ir)
+      for(int ig = box.lo[1]; ig <= box.hi[1]; ++ig)
+        for(int ib = box.lo[2]; ib <= box.hi[2]; ++ib) {
+          int bin = Local::bin(ir, ig, ib);
+          n += count[bin]; r += sumR[bin]; g += sumG[bin]; b += sumB[bin];
+        }
+    if(n > 0) palette << qRgb(r / n, g / n, b / n);
+  }
+
+  return palette;
+}
+
+int PixelKernels::nearestColor(const qint16* r, const qint16* g, const qint16* b, int count, int pr, int pg, int pb)
+{
+  int best = 0;
+  int bestDist = INT_MAX;
+  int i = 0;
+
+#ifdef __SSE2__
+  // Four palette entries per step: the channel differences are interleaved
+  // so that madd produces the 32-bit squared distances directly.
+  const __m128i vr = _mm_set1_epi16(pr);
+  const __m128i vg = _mm_set1_epi16(pg);
+  const __m128i vb = _mm_set1_epi16(pb);
+  const __m128i zero = _mm_setzero_si128();
+  __m128i bestD = _mm_set1_epi32(INT_MAX);
+  __m128i bestI = _mm_set1_epi32(0);
+  __m128i index = _mm_setr_epi32(0, 1, 2, 3);
+  const __m128i four = _mm_set1_epi32(4);
+
+  for(; i + 4 <= count; i += 4) {
+    __m128i dr = _mm_sub_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(r + i)), vr);
+    __m128i dg = _mm_sub_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(g + i)), vg);
+    __m128i db = _mm_sub_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(b + i)), vb);
+
+    __m128i rg = _mm_unpacklo_epi16(dr, dg);
+    __m128i bz = _mm_unpacklo_epi16(db, zero);
+    __m128i d = _mm_add_epi32(_mm_madd_epi16(rg, rg), _mm_madd_epi16(bz, bz));
+
+    __m128i less = _mm_cmplt_epi32(d, bestD);
+    bestD = _mm_or_si128(_mm_and_si128(less, d), _mm_andnot_si128(less, bestD));
+    bestI = _mm_or_si128(_mm_and_si128(less, index), _mm_andnot_si128(less, bestI));
+    index = _mm_add_epi32(index, four);
+  }
+
+  int lanesD[4], lanesI[4];
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(lanesD), bestD);
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(lanesI), bestI);
+  for(int lane = 0; lane < 4; ++lane) {
+    if(lanesD[lane] < bestDist || (lanesD[lane] == bestDist && lanesI[lane] < best)) {
+      bestDist = lanesD[lane];
+      best = lanesI[lane];
+    }
+  }
+#endif
+
+  // The tail only wins when strictly nearer, as its indices are higher.
+  if(i < count) {
+    int tail = i + nearestColorScalar(r + i, g + i, b + i, count - i, pr, pg, pb);
+    if(distance(r[tail], g[tail], b[tail], pr, pg, pb) < bestDist) best = tail;
+  }
+
+  return best;
+}
+
+int PixelKernels::nearestColorScalar(const qint16* r, const qint16* g, const qint16* b, int count,
+                                     int pr, int pg, int pb)
+{
+  int best = 0;
+  int bestDist = INT_MAX;
+
+  for(int i = 0; i < count; ++i) {
+    int d = distance(r[i], g[i], b[i], pr, pg, pb);
+    if(d < bestDist) {
+      bestDist = d;
+      best = i;
+    }
+  }
+
+  return best;
+}
+
+QImage Quantize::dithered(const QImage& image, int colors)
+{
+  QImage src = PixelFormat::toCanonical(image, "quantize");
+
+  QImage ret = exact(src, colors);
+  if(!ret.isNull()) return ret;
+
+  bool transparent = false;
+  for(int y = 0; y < src.height() && !transparent; ++y) {
+    auto in = reinterpret_cast<const QRgb*>(src.constScanLine(y));
+    for(int x = 0; x < src.width(); ++x)
+      if(qAlpha(in[x]) < TRANSPARENT_THRESHOLD) { transparent = true; break; }
+  }
+
+  QVector<QRgb> palette = medianCut(src, transparent ? colors - 1 : colors);
+  int n = palette.size();
+  if(transparent) palette << qRgba(0, 0, 0, 0);
+
+  QVector<qint16> pr(n), pg(n), pb(n);
+  for(int i = 0; i < n; ++i) {
+    pr[i] = qRed(palette[i]);
+    pg[i] = qGreen(palette[i]);
+    pb[i] = qBlue(palette[i]);
+  }
+
+  // Nearest colors are memoized at 6 bits per channel.
+  QVector<qint16> cache(1 << 18, -1);
+
+  ret = QImage(src.size(), QImage::Format_Indexed8);
+  int w = src.width();
+  QVector<int> error((w + 2) * 3 * 2, 0);
+  int* cur = error.data();
+  int* next = cur + (w + 2) * 3;
+
+  // Floyd-Steinberg error diffusion in straight RGB.
+  for(int y = 0; y < src.height(); ++y) {
+    auto in = reinterpret_cast<const QRgb*>(src.constScanLine(y));
+    uchar* out = ret.scanLine(y);
+    std::fill(next, next + (w + 2) * 3, 0);
+
+    for(int x = 0; x < w; ++x) {
+      if(qAlpha(in[x]) < TRANSPARENT_THRESHOLD) {
+        out[x] = n;
+        continue;
+      }
+
+      QRgb px = straight(in[x]);
+      int* e = cur + (x + 1) * 3;
+      int c[3] = {
+        qBound(0, qRed(px) + e[0] / 16, 255),
+        qBound(0, qGreen(px) + e[1] / 16, 255),
+        qBound(0, qBlue(px) + e[2] / 16, 255),
+      };
+
+      int key = ((c[0] >> 2) << 12) | ((c[1] >> 2) << 6) | (c[2] >> 2);
+      if(cache[key] < 0)
+        cache[key] = PixelKernels::nearestColor(pr.constData(), pg.constData(), pb.constData(), n,
+                                                c[0], c[1], c[2]);
+
+      int index = cache[key];
+      out[x] = index;
+
+      int err[3] = {c[0] - pr[index], c[1] - pg[index], c[2] - pb[index]};
+      for(int k = 0; k < 3; ++k) {
+        cur[(x + 2) * 3 + k] += err[k] * 7;
+        next[x * 3 + k] += err[k] * 3;
+        next[(x + 1) * 3 + k] += err[k] * 5;
+        next[(x + 2) * 3 + k] += err[k];
+      }
+    }
+
+    std::swap(cur, next);
+  }
+
+  ret.setColorTable(palette);
+  return ret;
+}
@@ -0,0 +1,15 @@
+#ifndef QUANTIZE_H
+#define QUANTIZE_H
+#include <QImage>
+#include <QVector>
+
+class Quantize
+{
+public:
+  static QImage exact(const QImage& image, int maxColors = 256);
+  static QImage dithered(const QImage& image, int colors = 256);
+
+private:
+  static QVector<QRgb> medianCut(const QImage& image, int colors);
+};
+#endif /* QUANTIZE_H */
@@ -0,0 +1,137 @@
+#include <algorithm>
+
+#include "RegionStats.hpp"
+#include "PixelFormat.hpp"
+#include "Parallel.hpp"
+
+namespace {
+  const int BLOCK_SHIFT = 6;
+  const int BLOCK = 1 << BLOCK_SHIFT;
+  const int BINS = 4 * 256;
+
+  inline void count(QRgb px, quint32* histogram)
+  {
+    if(qAlpha(px) != 255) px = qUnpremultiply(px);
+
+    ++histogram[qRed(px)];
+    ++histogram[256 + qGreen(px)];
+    ++histogram[512 + qBlue(px)];
+    ++histogram[768 + qAlpha(px)];
+  }
+}
+
+RegionStats::RegionStats()
+  : blocksX_(0), blocksY_(0)
+{
+}
+
+void RegionStats::build(const QImage& image)
+{
+  image_ = PixelFormat::toCanonical(image, "stats");
+  blocksX_ = (image_.width() + BLOCK - 1) >> BLOCK_SHIFT;
+  blocksY_ = (image_.height() + BLOCK - 1) >> BLOCK_SHIFT;
+
+  // A summed-area table over 64x64 blocks, each cell holding the histogram
+  // of all blocks above and to the left of it.
+  int stride = (blocksX_ + 1) * BINS;
+  sat_.fill(0, (blocksY_ + 1) * stride);
+  quint32* sat = sat_.data();
+
+  Parallel::forRange(blocksY_,
+                     [&](int begin, int end) {
+                       for(int by = begin; by < end; ++by) {
+                         for(int bx = 0; bx < blocksX_; ++bx) {
+                           QRect block(bx * BLOCK, by * BLOCK, BLOCK, BLOCK);
+                           this -> scan(block & image_.rect(), sat + (by + 1) * stride + (bx + 1) * BINS);
+                         }
+                       }
+                     });
+
+  for(int by = 1; by <= blocksY_; ++by) {
+    quint32* row = sat + by * stride;
+    for(int i = BINS; i < stride; ++i) row[i] += row[i - BINS];
+  }
+  for(int by = 2; by <= blocksY_; ++by) {
+    quint32* row = sat + by * stride;
+    const quint32* above = row - stride;
+    for(int i = 0; i < stride; ++i) row[i] += above[i];
+  }
+}
+
+const QImage& RegionStats::image() const
+{
+  return image_;
+}
+
+qint64 RegionStats::bytes() const
+{
+  return qint64(image_.bytesPerLine()) * image_.height() + qint64(sat_.size()) * sizeof(quint32);
+}
+
+const quint32* RegionStats::cell(int bx, int by) const
+{
+  return sat_.constData() + (by * (blocksX_ + 1) + bx) * BINS;
+}
+
+void RegionStats::scan(const QRect& rect, quint32* histogram) const
+{
+  for(int y = rect.top(); y <= rect.bottom(); ++y) {
+    auto line = reinterpret_cast<const QRgb*>(image_.constScanLine(y));
+    for(int x = rect.left(); x <= rect.right(); ++x) count(line[x], histogram);
+  }
+}
+
+RegionStats::Result RegionStats::query(const QRect& area) const
+{
+  Result ret;
+  ret.histogram.fill(0, BINS);
+  quint32* histogram = ret.histogram.data();
+  QRect rect = area.normalized() & image_.rect();
+
+  // Whole blocks come from the table in constant time; the partial blocks
+  // along the edges are scanned, so a query costs at most about 64 pixels
+  // per pixel of perimeter, whatever the area.
+  int bx0 = (rect.left() + BLOCK - 1) >> BLOCK_SHIFT;
+  int by0 = (rect.top() + BLOCK - 1) >> BLOCK_SHIFT;
+  int bx1 = (rect.right() + 1 == image_.width()) ? blocksX_ : (rect.right() + 1) >> BLOCK_SHIFT;
+  int by1 = (rect.bottom() + 1 == image_.height()) ? blocksY_ : (rect.bottom() + 1) >> BLOCK_SHIFT;
+
+  if(bx0 >= bx1 || by0 >= by1) {
+    this -> scan(rect, histogram);
+  }
+  else {
+    const quint32* a = cell(bx0, by0);
+    const quint32* b = cell(bx1, by0);
+    const quint32* c = cell(bx0, by1);
+    const quint32* d = cell(bx1, by1);
+    for(int i = 0; i < BINS; ++i) histogram[i] = d[i] - b[i] - c[i] + a[i];
+
+    QRect inner(QPoint(bx0 * BLOCK, by0 * BLOCK),
+                QPoint(std::min(bx1 * BLOCK, image_.width()) - 1, std::min(by1 * BLOCK, image_.height()) - 1));
+
+    this -> scan(QRect(QPoint(rect.left(), rect.top()), QPoint(rect.right(), inner.top() - 1)), histogram);
+    this -> scan(QRect(QPoint(rect.left(), inner.bottom() + 1), QPoint(rect.right(), rect.bottom())), histogram);
+    this -> scan(QRect(QPoint(rect.left(), inner.top()), QPoint(inner.left() - 1, inner.bottom())), histogram);
+    this -> scan(QRect(QPoint(inner.right() + 1, inner.top()), QPoint(rect.right(), inner.bottom())), histogram);
+  }
+
+  ret.count = 0;
+  for(int i = 0; i < 256; ++i) ret.count += histogram[768 + i];
+
+  for(int ch = 0; ch < 4; ++ch) {
+    const quint32* bins = histogram + ch * 256;
+    qint64 sum = 0;
+
+    ret.min[ch] = 255;
+    ret.max[ch] = 0;
+    for(int v = 0; v < 256; ++v) {
+      if(bins[v] == 0) continue;
+      ret.min[ch] = std::min(ret.min[ch], v);
+      ret.max[ch] = v;
+      sum += qint64(bins[v]) * v;
+    }
+    ret.mean[ch] = ret.count > 0 ? double(sum) / ret.count : 0.0;
+  }
+
+  return ret;
+}
@@ -0,0 +1,38 @@
+#ifndef REGIONSTATS_H
+#define REGIONSTATS_H
+#include <QImage>
+#include <QVector>
+#include <QRect>
+
+class RegionStats
+{
+public:
+  // Channels are indexed R, G, B, A, with straight (not premultiplied) values.
+  struct Result {
+    qint64 count;
+    int min[4];
+    int max[4];
+    double mean[4];
+    QVector<quint32> histogram;
+  };
+
+  RegionStats();
+
+  // build() is linear in the image. query() adds 64x64 blocks from a
+  // summed-area table and scans the partial blocks along the edges, so its
+  // cost grows with the perimeter of the region, not its area.
+
+  void build(const QImage& image);
+  const QImage& image() const;
+  qint64 bytes() const;
+  Result query(const QRect& rect) const;
+
+private:
+  void scan(const QRect& rect, quint32* histogram) const;
+  const quint32* cell(int bx, int by) const;
+
+  QImage image_;
+  int blocksX_, blocksY_;
+  QVector<quint32> sat_;
+};
+#endif /* REGIONSTATS_H */
@@ -0,0 +1,257 @@
+#include <QtMath>
+#include <algorithm>
+#include <cmath>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "Resample.hpp"
+#include "PixelKernels.hpp"
+#include "PixelFormat.hpp"
+#include "Parallel.hpp"
+
+namespace {
+  const int LOBES = 3;
+  const int WEIGHT_BITS = 14;
+  const int WEIGHT_ONE = 1 << WEIGHT_BITS;
+
+  double lanczos(double x)
+  {
+    if(x < 0) x = -x;
+    if(x < 1e-8) return 1.0;
+    if(x >= LOBES) return 0.0;
+
+    double px = M_PI * x;
+    return LOBES * std::sin(px) * std::sin(px / LOBES) / (px * px);
+  }
+
+  // Premultiplied channels must not exceed their alpha after the negative
+  // lobes have overshot.
+  inline quint32 clampPixel(int a, int r, int g, int b)
+  {
+    a = qBound(0, a, 255);
+    return (quint32(a) << 24) | (quint32(qBound(0, r, a)) << 16) |
+      (quint32(qBound(0, g, a)) << 8) | quint32(qBound(0, b, a));
+  }
+
+  inline quint32 roundPixel(int a, int r, int g, int b)
+  {
+    const int half = WEIGHT_ONE / 2;
+    return clampPixel((a + half) >> WEIGHT_BITS, (r + half) >> WEIGHT_BITS,
+                      (g + half) >> WEIGHT_BITS, (b + half) >> WEIGHT_BITS);
+  }
+
+#ifdef __SSE2__
+  inline __m128i clampPixels(__m128i acc0, __m128i acc1)
+  {
+    const __m128i half = _mm_set1_epi32(WEIGHT_ONE / 2);
+    acc0 = _mm_srai_epi32(_mm_add_epi32(acc0, half), WEIGHT_BITS);
+    acc1 = _mm_srai_epi32(_mm_add_epi32(acc1, half), WEIGHT_BITS);
+
+    __m128i px = _mm_packs_epi32(acc0, acc1);
+    px = _mm_packus_epi16(px, px);
+
+    __m128i alpha = _mm_srli_epi32(px, 24);
+    alpha = _mm_or_si128(alpha, _mm_slli_epi32(alpha, 8));
+    alpha = _mm_or_si128(alpha, _mm_slli_epi32(alpha, 16));
+    return _mm_min_epu8(px, alpha);
+  }
+#endif
+}
+
+Resample::Kernel Resample::kernel(int src, int dst)
+{
+  Kernel ret;
+  double scale = double(dst) / src;
+  double filterScale = std::max(1.0, 1.0 / scale);
+  double support = LOBES * filterScale;
+
+  ret.taps = std::min(int(std::ceil(support * 2)) + 1, src);
+  ret.begin.resize(dst);
+  ret.weights.fill(0, dst * ret.taps);
+
+  QVector<double> weights(ret.taps);
+
+  for(int i = 0; i < dst; ++i) {
+    double center = (i + 0.5) / scale;
+    int first = std::max(0, int(std::floor(center - support)));
+    int last = std::min(src - 1, int(std::ceil(center + support)));
+    first = std::max(0, std::min(first, src - ret.taps));
+    last = std::min(last, first + ret.taps - 1);
+
+    double sum = 0;
+    for(int j = 0; j < ret.taps; ++j) {
+      weights[j] = (first + j <= last) ? lanczos((first + j + 0.5 - center) / filterScale) : 0.0;
+      sum += weights[j];
+    }
+
+    // Fixed point weights sum to exactly one; the rounding error goes to
+    // the largest tap.
+    qint16* w = ret.weights.data() + i * ret.taps;
+    int total = 0, largest = 0;
+    for(int j = 0; j < ret.taps; ++j) {
+      w[j] = qint16(std::lround(weights[j] / sum * WEIGHT_ONE));
+      total += w[j];
+      if(w[j] > w[largest]) largest = j;
+    }
+    w[largest] += WEIGHT_ONE - total;
+    ret.begin[i] = first;
+  }
+
+  return ret;
+}
+
+void PixelKernels::resampleRowScalar(const quint32* src, quint32* dst, int width,
+                                     const int* begin, const qint16* weights, int taps)
+{
+  for(int x = 0; x < width; ++x) {
+    const quint32* p = src + begin[x];
+    const qint16* w = weights + x * taps;
+    int a = 0, r = 0, g = 0, b = 0;
+
+    for(int j = 0; j < taps; ++j) {
+      a += qAlpha(p[j]) * w[j];
+      r += qRed(p[j]) * w[j];
+      g += qGreen(p[j]) * w[j];
+      b += qBlue(p[j]) * w[j];
+    }
+
+    dst[x] = roundPixel(a, r, g, b);
+  }
+}
+
+void PixelKernels::resampleRow(const quint32* src, quint32* dst, int width,
+                               const int* begin, const qint16* weights, int taps)
+{
+#ifdef __SSE2__
+  const __m128i zero = _mm_setzero_si128();
+
+  for(int x = 0; x < width; ++x) {
+    const quint32* p = src + begin[x];
+    const qint16* w = weights + x * taps;
+    int j = 0;
+
+    // Two taps per madd: the channels of both pixels are interleaved so each
+    // 32-bit lane sums one channel.
+    __m128i acc = _mm_setzero_si128();
+
+    for(; j + 2 <= taps; j += 2) {
+      __m128i px = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(p + j)), zero);
+      __m128i pair = _mm_unpacklo_epi16(px, _mm_srli_si128(px, 8));
+      __m128i weight = _mm_set1_epi32((quint32(quint16(w[j + 1])) << 16) | quint16(w[j]));
+      acc = _mm_add_epi32(acc, _mm_madd_epi16(pair, weight));
+    }
+    if(j < taps) {
+      __m128i px = _mm_unpacklo_epi8(_mm_cvtsi32_si128(p[j]), zero);
+      __m128i pair = _mm_unpacklo_epi16(px, zero);
+      acc = _mm_add_epi32(acc, _mm_madd_epi16(pair, _mm_set1_epi32(quint16(w[j]))));
+    }
+
+    dst[x] = _mm_cvtsi128_si32(clampPixels(acc, acc));
+  }
+#else
+  resampleRowScalar(src, dst, width, begin, weights, taps);
+#endif
+}
+
+void PixelKernels::resampleColumnsScalar(const quint32* const* rows, quint32* dst, int width,
+                                         const qint16* w, int taps, int from)
+{
+  for(int x = from; x < width; ++x) {
+    int a = 0, r = 0, g = 0, b = 0;
+    for(int j = 0; j < taps; ++j) {
+      quint32 p = rows[j][x];
+      a += qAlpha(p) * w[j];
+      r += qRed(p) * w[j];
+      g += qGreen(p) * w[j];
+      b += qBlue(p) * w[j];
+    }
+
+    dst[x] = roundPixel(a, r, g, b);
+  }
+}
+
+void PixelKernels::resampleColumns(const quint32* const* rows, quint32* dst, int width,
+                                   const qint16* w, int taps)
+{
+  int x = 0;
+
+#ifdef __SSE2__
+  // Two rows per madd, four pixels per step.
+  const __m128i zero = _mm_setzero_si128();
+
+  for(; x + 4 <= width; x += 4) {
+    __m128i acc[4] = {zero, zero, zero, zero};
+
+    for(int j = 0; j < taps; j += 2) {
+      bool pair = j + 1 < taps;
+      __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rows[j] + x));
+      __m128i b = pair ? _mm_loadu_si128(reinterpret_cast<const __m128i*>(rows[j + 1] + x)) : zero;
+      __m128i weight = _mm_set1_epi32((quint32(quint16(pair ? w[j + 1] : 0)) << 16) | quint16(w[j]));
+
+      __m128i aLo = _mm_unpacklo_epi8(a, zero), aHi = _mm_unpackhi_epi8(a, zero);
+      __m128i bLo = _mm_unpacklo_epi8(b, zero), bHi = _mm_unpackhi_epi8(b, zero);
+
+      acc[0] = _mm_add_epi32(acc[0], _mm_madd_epi16(_mm_unpacklo_epi16(aLo, bLo), weight));
+      acc[1] = _mm_add_epi32(acc[1], _mm_madd_epi16(_mm_unpackhi_epi16(aLo, bLo), weight));
+      acc[2] = _mm_add_epi32(acc[2], _mm_madd_epi16(_mm_unpacklo_epi16(aHi, bHi), weight));
+      acc[3] = _mm_add_epi32(acc[3], _mm_madd_epi16(_mm_unpackhi_epi16(aHi, bHi), weight));
+    }
+
+    __m128i lo = clampPixels(acc[0], acc[1]);
+    __m128i hi = clampPixels(acc[2], acc[3]);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x), _mm_unpacklo_epi64(lo, hi));
+  }
+#endif
+
+  resampleColumnsScalar(rows, dst, width, w, taps, x);
+}
+
+QImage Resample::scaled(const QImage& image, const QSize& size)
+{
+  QImage src = PixelFormat::toCanonical(image, "resample");
+  if(src.isNull() || size.isEmpty() || size == src.size()) return src;
+
+  int dw = size.width();
+  int dh = size.height();
+  auto hKernel = kernel(src.width(), dw);
+  auto vKernel = kernel(src.height(), dh);
+
+  // Raw pointers are taken up front; scanLine() may detach in the workers.
+  QImage tmp(dw, src.height(), PixelFormat::CANONICAL);
+  QImage ret(dw, dh, PixelFormat::CANONICAL);
+  const uchar* srcBits = src.constBits();
+  uchar* tmpBits = tmp.bits();
+  uchar* retBits = ret.bits();
+  int srcStride = src.bytesPerLine();
+  int tmpStride = tmp.bytesPerLine();
+  int retStride = ret.bytesPerLine();
+
+  Parallel::forRange(src.height(),
+                     [&](int begin, int end) {
+                       for(int y = begin; y < end; ++y)
+                         PixelKernels::resampleRow(reinterpret_cast<const quint32*>(srcBits + y * srcStride),
+                                                   reinterpret_cast<quint32*>(tmpBits + y * tmpStride), dw,
+                                                   hKernel.begin.constData(), hKernel.weights.constData(),
+                                                   hKernel.taps);
+                     },
+                     16);
+
+  Parallel::forRange(dh,
+                     [&](int begin, int end) {
+                       QVector<const quint32*> rows(vKernel.taps);
+                       for(int y = begin; y < end; ++y) {
+                         for(int j = 0; j < vKernel.taps; ++j)
+                           rows[j] = reinterpret_cast<const quint32*>(tmpBits + (vKernel.begin[y] + j) * tmpStride);
+
+                         PixelKernels::resampleColumns(rows.constData(),
+                                                       reinterpret_cast<quint32*>(retBits + y * retStride), dw,
+                                                       vKernel.weights.constData() + y * vKernel.taps,
+                                                       vKernel.taps);
+                       }
+                     },
+                     16);
+
+  return ret;
+}
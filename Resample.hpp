@@ -0,0 +1,20 @@
+#ifndef RESAMPLE_H
+#define RESAMPLE_H
+#include <QImage>
+#include <QVector>
+
+class Resample
+{
+public:
+  static QImage scaled(const QImage& image, const QSize& size);
+
+private:
+  struct Kernel {
+    int taps;
+    QVector<int> begin;
+    QVector<qint16> weights;
+  };
+
+  static Kernel kernel(int src, int dst);
+};
+#endif /* RESAMPLE_H */
@@ -0,0 +1,155 @@
+#include <QHash>
+#include <cstring>
+
+#include "ScrollStitcher.hpp"
+#include "PixelFormat.hpp"
+
+namespace {
+  const int MAX_ANCHORS = 8;
+}
+
+ScrollStitcher::ScrollStitcher(int maxHeight)
+  : frames_(0), footer_(-1), height_(0), maxHeight_(maxHeight)
+{
+}
+
+QVector<quint64> ScrollStitcher::rowHashes(const QImage& image)
+{
+  QVector<quint64> ret(image.height());
+  int words = image.width() / 2;
+
+  for(int y = 0; y < image.height(); ++y) {
+    const uchar* line = image.constScanLine(y);
+    quint64 hash = 0xcbf29ce484222325ull;
+
+    // Two pixels per step, then the odd pixel.
+    for(int i = 0; i < words; ++i) {
+      quint64 v;
+      std::memcpy(&v, line + i * 8, 8);
+      hash = (hash ^ v) * 0x100000001b3ull;
+      hash ^= hash >> 29;
+    }
+    if(image.width() % 2 != 0) {
+      quint32 v;
+      std::memcpy(&v, line + words * 8, 4);
+      hash = (hash ^ v) * 0x100000001b3ull;
+    }
+
+    ret[y] = hash ^ (hash >> 32);
+  }
+
+  return ret;
+}
+
+int ScrollStitcher::findShift(const QVector<quint64>& prev, const QVector<quint64>& cur, int top, int bottom)
+{
+  // Rows of the previous frame whose hash is unique anchor the search; blank
+  // or repeated rows would match anywhere.
+  QHash<quint64, int> positions;
+  for(int y = top; y < bottom; ++y) {
+    auto it = positions.find(prev[y]);
+    if(it == positions.end()) positions.insert(prev[y], y);
+    else it.value() = -1;
+  }
+
+  int anchors = 0;
+  for(int y = top; y < bottom && anchors < MAX_ANCHORS; ++y) {
+    int pos = positions.value(cur[y], -1);
+    if(pos < 0) continue;
+
+    ++anchors;
+    int shift = pos - y;
+    if(shift <= 0) continue;
+
+    // The whole overlap must agree, compared by hash only.
+    bool match = true;
+    for(int i = top; i + shift < bottom && match; ++i) {
+      if(cur[i] != prev[i + shift]) match = false;
+    }
+    if(match) return shift;
+  }
+
+  return -1;
+}
+
+bool ScrollStitcher::addFrame(const QImage& image)
+{
+  QImage frame = PixelFormat::toCanonical(image, "scroll");
+  if(frame.isNull() || this -> isFull()) return false;
+
+  auto hashes = rowHashes(frame);
+  int h = frame.height();
+
+  if(frames_ == 0) {
+    prevHashes_ = hashes;
+    last_ = frame;
+    frames_ = 1;
+    return true;
+  }
+  if(frame.size() != last_.size()) return false;
+
+  // Rows that stay put between frames are fixed headers and footers.
+  int top = 0;
+  while(top < h && hashes[top] == prevHashes_[top]) ++top;
+  if(top == h) return false;
+
+  int bottom = h;
+  while(bottom > top && hashes[bottom - 1] == prevHashes_[bottom - 1]) --bottom;
+
+  int shift = findShift(prevHashes_, hashes, top, bottom);
+  if(shift < 0) return false;
+
+  if(footer_ < 0) {
+    footer_ = h - bottom;
+    strips_ << last_.copy(0, 0, last_.width(), h - footer_);
+    height_ = h - footer_;
+  }
+
+  // Only the rows scrolled into view are kept.
+  int rows = qMin(shift, h - footer_);
+  rows = qMin(rows, maxHeight_ - height_ - footer_);
+  if(rows > 0) {
+    strips_ << frame.copy(0, h - footer_ - rows, frame.width(), rows);
+    height_ += rows;
+  }
+
+  prevHashes_ = hashes;
+  last_ = frame;
+  ++frames_;
+
+  return rows > 0;
+}
+
+int ScrollStitcher::frames() const
+{
+  return frames_;
+}
+
+int ScrollStitcher::height() const
+{
+  return height_ + qMax(footer_, 0);
+}
+
+bool ScrollStitcher::isFull() const
+{
+  return this -> height() >= maxHeight_;
+}
+
+QImage ScrollStitcher::result() const
+{
+  if(strips_.isEmpty()) return last_;
+
+  QImage ret(last_.width(), this -> height(), last_.format());
+  int bytes = last_.width() * 4;
+  int y = 0;
+
+  auto copyRows = [&](const QImage& src, int from, int count) {
+    for(int i = 0; i < count; ++i, ++y)
+      std::memcpy(ret.scanLine(y), src.constScanLine(from + i), bytes);
+  };
+
+  for(auto& strip: strips_) copyRows(strip, 0, strip.height());
+  copyRows(last_, last_.height() - footer_, footer_);
+
+  return ret;
+}
@@ -0,0 +1,30 @@
+#ifndef SCROLLSTITCHER_H
+#define SCROLLSTITCHER_H
+#include <QImage>
+#include <QVector>
+#include <QList>
+
+class ScrollStitcher
+{
+public:
+  ScrollStitcher(int maxHeight = 32000);
+
+  bool addFrame(const QImage& frame);
+  int frames() const;
+  int height() const;
+  bool isFull() const;
+  QImage result() const;
+
+private:
+  static QVector<quint64> rowHashes(const QImage& image);
+  static int findShift(const QVector<quint64>& prev, const QVector<quint64>& cur, int top, int bottom);
+
+  QVector<quint64> prevHashes_;
+  QImage last_;
+  QList<QImage> strips_;
+  int frames_;
+  int footer_;
+  int height_;
+  int maxHeight_;
+};
+#endif /* SCROLLSTITCHER_H */
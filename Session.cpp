@@ -0,0 +1,170 @@
+#include <QDir>
+#include <QFile>
+#include <QSaveFile>
+#include <QDataStream>
+#include <QStandardPaths>
+#include <QUuid>
+
+#include "Session.hpp"
+#include "Qoi.hpp"
+#include "PixelFormat.hpp"
+
+namespace {
+  const quint32 IMAGE_MAGIC = 0x5852494d; // "XRIM"
+  const quint32 IMAGE_VERSION = 1;
+  const int IMAGE_HEADER_SIZE = 32;
+
+  enum Encoding {
+    RAW = 0,
+    QOI = 1,
+  };
+
+  void unmapImage(void* info)
+  {
+    delete static_cast<QFile*>(info);
+  }
+}
+
+bool Session::enabled_ = false;
+
+void Session::setEnabled(bool enabled)
+{
+  enabled_ = enabled;
+}
+
+bool Session::isEnabled()
+{
+  return enabled_;
+}
+
+QString Session::directory()
+{
+  return QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + "/session";
+}
+
+QString Session::newPinId()
+{
+  return QUuid::createUuid().toRfc4122().toHex();
+}
+
+QStringList Session::pinIds()
+{
+  QStringList ret;
+  QDir dir(directory());
+
+  for(auto name: dir.entryList(QStringList() << "*.pin", QDir::Files, QDir::Time | QDir::Reversed)) {
+    auto id = name.left(name.size() - 4);
+    if(dir.exists(id + ".img")) ret << id;
+  }
+
+  return ret;
+}
+
+bool Session::saveImage(const QString& id, const QImage& image)
+{
+  QImage img = PixelFormat::toCanonical(image, "session");
+
+  qint64 rawSize = qint64(img.bytesPerLine()) * img.height();
+  QByteArray qoi = Qoi::encode(img);
+
+  // Keep the raw pixels when compression does not pay off, or the image is
+  // too large for QOI, so they can be mapped straight into a QImage on
+  // restore.
+  quint32 encoding = (!qoi.isEmpty() && qoi.size() < rawSize * 3 / 4) ? QOI : RAW;
+
+  QDir().mkpath(directory());
+  QSaveFile file(directory() + "/" + id + ".img");
+  if(!file.open(QIODevice::WriteOnly)) return false;
+
+  QByteArray header;
+  QDataStream out(&header, QIODevice::WriteOnly);
+  out << IMAGE_MAGIC << IMAGE_VERSION << encoding << quint32(img.format())
+      << quint32(img.width()) << quint32(img.height()) << quint32(img.bytesPerLine())
+      << quint32(encoding == QOI ? qoi.size() : rawSize);
+  file.write(header);
+
+  if(encoding == QOI)
+    file.write(qoi);
+  else
+    file.write(reinterpret_cast<const char*>(img.constBits()), rawSize);
+
+  return file.commit();
+}
+
+QImage Session::loadImage(const QString& id)
+{
+  QFile* file = new QFile(directory() + "/" + id + ".img");
+
+  if(!file -> open(QIODevice::ReadOnly) || file -> size() < IMAGE_HEADER_SIZE) {
+    delete file;
+    return QImage();
+  }
+
+  const uchar* data = file -> map(0, file -> size());
+  if(data == 0) {
+    delete file;
+    return QImage();
+  }
+
+  quint32 magic, version, encoding, format, width, height, bytesPerLine, size;
+  QDataStream in(QByteArray::fromRawData(reinterpret_cast<const char*>(data), IMAGE_HEADER_SIZE));
+  in >> magic >> version >> encoding >> format >> width >> height >> bytesPerLine >> size;
+
+  if(magic != IMAGE_MAGIC || version != IMAGE_VERSION ||
+     IMAGE_HEADER_SIZE + qint64(size) > file -> size()) {
+    delete file;
+    return QImage();
+  }
+
+  const uchar* bits = data + IMAGE_HEADER_SIZE;
+
+  if(encoding == QOI) {
+    QImage img = Qoi::decode(reinterpret_cast<const char*>(bits), size);
+    delete file;
+    return img;
+  }
+
+  // Raw pixels are mapped as they are, so the header must describe rows
+  // that fit in the file.
+  if(format != quint32(PixelFormat::CANONICAL) || width == 0 || height == 0 ||
+     qint64(bytesPerLine) < qint64(width) * 4 || qint64(bytesPerLine) * height > size) {
+    delete file;
+    return QImage();
+  }
+
+  // The image reads straight from the mapping; the file is closed and
+  // unmapped once the last copy of the image is released.
+  return QImage(bits, width, height, bytesPerLine, QImage::Format(format), unmapImage, file);
+}
+
+bool Session::saveState(const QString& id, const QByteArray& state)
+{
+  QDir().mkpath(directory());
+  QSaveFile file(directory() + "/" + id + ".pin");
+  if(!file.open(QIODevice::WriteOnly)) return false;
+
+  file.write(state);
+  return file.commit();
+}
+
+QByteArray Session::loadState(const QString& id)
+{
+  QFile file(directory() + "/" + id + ".pin");
+  if(!file.open(QIODevice::ReadOnly)) return QByteArray();
+
+  return file.readAll();
+}
+
+QString Session::journalPath(const QString& id)
+{
+  return directory() + "/" + id + ".jnl";
+}
+
+void Session::remove(const QString& id)
+{
+  QDir dir(directory());
+
+  dir.remove(id + ".pin");
+  dir.remove(id + ".img");
+  dir.remove(id + ".jnl");
+}
@@ -0,0 +1,28 @@
+#ifndef SESSION_H
+#define SESSION_H
+#include <QString>
+#include <QStringList>
+#include <QByteArray>
+#include <QImage>
+
+class Session
+{
+public:
+  static void setEnabled(bool enabled);
+  static bool isEnabled();
+
+  static QString directory();
+  static QString newPinId();
+  static QStringList pinIds();
+
+  static bool saveImage(const QString& id, const QImage& image);
+  static QImage loadImage(const QString& id);
+  static bool saveState(const QString& id, const QByteArray& state);
+  static QByteArray loadState(const QString& id);
+  static QString journalPath(const QString& id);
+  static void remove(const QString& id);
+
+private:
+  static bool enabled_;
+};
+#endif /* SESSION_H */
@@ -0,0 +1,134 @@
+#include <QFile>
+#include <QBuffer>
+#include <QImageReader>
+#include <QImageWriter>
+#include <QFileInfo>
+#include <iostream>
+#include <stdio.h>
+
+#include "StreamIO.hpp"
+#include "PixelFormat.hpp"
+
+QImage StreamIO::readStdin(const QSize& rawSize)
+{
+  QFile in;
+  if(!in.open(stdin, QIODevice::ReadOnly)) return QImage();
+
+  return readImage(&in, rawSize);
+}
+
+QImage StreamIO::readImage(QIODevice* device, const QSize& rawSize)
+{
+  QByteArray data = device -> readAll();
+
+  if(rawSize.isValid()) return decodeRaw(data, rawSize);
+  if(data.startsWith("P7")) return decodePam(data);
+
+  // PNG, PPM/PGM/PBM and the other formats Qt can sniff from content.
+  QBuffer buffer(&data);
+  buffer.open(QIODevice::ReadOnly);
+  QImageReader reader(&buffer);
+
+  return PixelFormat::toCanonical(reader.read(), "stdin");
+}
+
+QImage StreamIO::decodeRaw(const QByteArray& data, const QSize& size)
+{
+  qint64 bytes = qint64(size.width()) * size.height() * 4;
+  if(size.isEmpty() || data.size() < bytes) {
+    std::cerr << "raw input is " << data.size() << " bytes, expected " << bytes << std::endl;
+    return QImage();
+  }
+
+  QImage img(reinterpret_cast<const uchar*>(data.constData()), size.width(), size.height(),
+             size.width() * 4, QImage::Format_RGBA8888);
+
+  return PixelFormat::toCanonical(img, "stdin");
+}
+
+QImage StreamIO::decodePam(const QByteArray& data)
+{
+  int width = 0, height = 0, depth = 0, maxval = 0;
+  int pos = 0;
+
+  for(;;) {
+    int end = data.indexOf('\n', pos);
+    if(end < 0) return QImage();
+
+    auto line = data.mid(pos, end - pos).trimmed();
+    pos = end + 1;
+
+    if(line == "ENDHDR") break;
+    if(line.isEmpty() || line.startsWith('#') || line == "P7") continue;
+
+    auto fields = line.split(' ');
+    if(fields.size() < 2) continue;
+
+    if(fields[0] == "WIDTH") width = fields[1].toInt();
+    else if(fields[0] == "HEIGHT") height = fields[1].toInt();
+    else if(fields[0] == "DEPTH") depth = fields[1].toInt();
+    else if(fields[0] == "MAXVAL") maxval = fields[1].toInt();
+  }
+
+  if(width <= 0 || height <= 0 || depth < 1 || depth > 4 || maxval != 255) {
+    std::cerr << "unsupported PAM header" << std::endl;
+    return QImage();
+  }
+  if(data.size() - pos < qint64(width) * height * depth) return QImage();
+
+  // Gray, gray+alpha, RGB or RGBA tuples, eight bits per sample.
+  QImage img(width, height, QImage::Format_ARGB32);
+  auto src = reinterpret_cast<const uchar*>(data.constData()) + pos;
+
+  for(int y = 0; y < height; ++y) {
+    QRgb* row = reinterpret_cast<QRgb*>(img.scanLine(y));
+
+    for(int x = 0; x < width; ++x, src += depth) {
+      switch(depth) {
+      case 1: row[x] = qRgb(src[0], src[0], src[0]); break;
+      case 2: row[x] = qRgba(src[0], src[0], src[0], src[1]); break;
+      case 3: row[x] = qRgb(src[0], src[1], src[2]); break;
+      case 4: row[x] = qRgba(src[0], src[1], src[2], src[3]); break;
+      }
+    }
+  }
+
+  return PixelFormat::toCanonical(img, "stdin");
+}
+
+QByteArray StreamIO::formatFor(const QString& target)
+{
+  // Streams are PNG; files take the format of their suffix when known.
+  if(target == "-" || target.startsWith("fd:")) return "png";
+
+  auto suffix = QFileInfo(target).suffix().toLower().toLatin1();
+  return QImageWriter::supportedImageFormats().contains(suffix) ? suffix : QByteArray("png");
+}
+
+bool StreamIO::writeImage(const QImage& image, const QString& target)
+{
+  QFile out;
+  bool ok;
+
+  if(target == "-") {
+    ok = out.open(stdout, QIODevice::WriteOnly);
+  }
+  else if(target.startsWith("fd:")) {
+    ok = out.open(target.mid(3).toInt(), QIODevice::WriteOnly);
+  }
+  else {
+    out.setFileName(target);
+    ok = out.open(QIODevice::WriteOnly);
+  }
+
+  if(!ok) {
+    std::cerr << "cannot open " << target.toStdString() << std::endl;
+    return false;
+  }
+
+  QImageWriter writer(&out, formatFor(target));
+  ok = writer.write(image);
+  out.flush();
+
+  return ok;
+}
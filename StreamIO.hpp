@@ -0,0 +1,19 @@
+#ifndef STREAMIO_H
+#define STREAMIO_H
+#include <QImage>
+#include <QSize>
+
+class QIODevice;
+class StreamIO
+{
+public:
+  static QImage readImage(QIODevice* device, const QSize& rawSize = QSize());
+  static QImage readStdin(const QSize& rawSize = QSize());
+  static bool writeImage(const QImage& image, const QString& target);
+  static QByteArray formatFor(const QString& target);
+
+private:
+  static QImage decodePam(const QByteArray& data);
+  static QImage decodeRaw(const QByteArray& data, const QSize& size);
+};
+#endif /* STREAMIO_H */
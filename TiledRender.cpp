@@ -0,0 +1,91 @@
+#include <QGraphicsScene>
+#include <QGraphicsItem>
+#include <QGraphicsPixmapItem>
+#include <QStyleOptionGraphicsItem>
+#include <QPainter>
+
+#include "TiledRender.hpp"
+#include "PixelFormat.hpp"
+#include "Parallel.hpp"
+
+QVector<TiledRender::Entry> TiledRender::snapshot(QGraphicsScene* scene, const QRectF& rect)
+{
+  QVector<Entry> ret;
+
+  // Everything the painters need is read here, on the GUI thread; item
+  // transforms and bounds are computed lazily and cached by Qt.
+  for(auto item: scene -> items(rect, Qt::IntersectsItemBoundingRect, Qt::AscendingOrder)) {
+    if(!item -> isVisible()) continue;
+
+    Entry entry = {item, item -> sceneTransform(), item -> effectiveOpacity(),
+                   item -> boundingRect(), item -> sceneBoundingRect(), QImage(), QPointF(), false};
+
+    if(auto pixmapItem = qgraphicsitem_cast<QGraphicsPixmapItem*>(item)) {
+      entry.image = PixelFormat::fromPixmap(pixmapItem -> pixmap(), "tile");
+      entry.offset = pixmapItem -> offset();
+      entry.smooth = pixmapItem -> transformationMode() == Qt::SmoothTransformation;
+    }
+    ret << entry;
+  }
+
+  return ret;
+}
+
+void TiledRender::paint(QPainter* painter, const QVector<Entry>& entries, const QRect& rect)
+{
+  QTransform base = painter -> transform();
+  QStyleOptionGraphicsItem option;
+
+  for(auto& entry: entries) {
+    if(!entry.sceneBounds.intersects(rect)) continue;
+
+    option.exposedRect = entry.bounds;
+    painter -> setTransform(entry.transform * base);
+    painter -> setOpacity(entry.opacity);
+
+    if(!entry.image.isNull()) {
+      painter -> save();
+      painter -> setRenderHint(QPainter::SmoothPixmapTransform, entry.smooth);
+      painter -> drawImage(entry.offset, entry.image);
+      painter -> restore();
+    }
+    else if(qgraphicsitem_cast<QGraphicsPixmapItem*>(entry.item) == 0) {
+      entry.item -> paint(painter, &option, 0);
+    }
+  }
+
+  painter -> setTransform(base);
+  painter -> setOpacity(1.0);
+}
+
+QImage TiledRender::render(const QVector<Entry>& entries, const QRect& rect, int tileSize)
+{
+  QImage ret(rect.size(), PixelFormat::CANONICAL);
+  if(ret.isNull()) return ret;
+
+  int tilesX = (rect.width() + tileSize - 1) / tileSize;
+  int tilesY = (rect.height() + tileSize - 1) / tileSize;
+  uchar* bits = ret.bits();
+  int stride = ret.bytesPerLine();
+
+  // Each tile paints into a view of its part of the output with its own
+  // painter. Integer translations keep the pixels identical to one pass.
+  Parallel::forRange(tilesX * tilesY,
+                     [&](int begin, int end) {
+                       for(int i = begin; i < end; ++i) {
+                         QRect tile(QPoint((i % tilesX) * tileSize, (i / tilesX) * tileSize), QSize(tileSize, tileSize));
+                         tile &= QRect(QPoint(0, 0), rect.size());
+
+                         QImage view(bits + tile.y() * stride + tile.x() * 4, tile.width(), tile.height(),
+                                     stride, PixelFormat::CANONICAL);
+                         view.fill(Qt::transparent);
+
+                         QPainter painter(&view);
+                         painter.setRenderHints(QPainter::Antialiasing | QPainter::HighQualityAntialiasing);
+                         painter.translate(-tile.x() - rect.x(), -tile.y() - rect.y());
+                         paint(&painter, entries, tile.translated(rect.topLeft()));
+                       }
+                     });
+
+  return ret;
+}
@@ -0,0 +1,31 @@
+#ifndef TILEDRENDER_H
+#define TILEDRENDER_H
+#include <QImage>
+#include <QVector>
+#include <QTransform>
+
+class QGraphicsScene;
+class QGraphicsItem;
+class QPainter;
+
+class TiledRender
+{
+public:
+  struct Entry {
+    QGraphicsItem* item;
+    QTransform transform;
+    qreal opacity;
+    QRectF bounds;
+    QRectF sceneBounds;
+    // Pixmap items are drawn from their backing image; QPixmap may only be
+    // painted on the GUI thread.
+    QImage image;
+    QPointF offset;
+    bool smooth;
+  };
+
+  static QVector<Entry> snapshot(QGraphicsScene* scene, const QRectF& rect);
+  static void paint(QPainter* painter, const QVector<Entry>& entries, const QRect& rect);
+  static QImage render(const QVector<Entry>& entries, const QRect& rect, int tileSize = 512);
+};
+#endif /* TILEDRENDER_H */
@@ -0,0 +1,42 @@
+#include <iostream>
+#include <algorithm>
+
+#include "TimingStats.hpp"
+
+void TimingStats::add(qint64 nsec)
+{
+  samples_.push_back(nsec);
+}
+
+void TimingStats::clear()
+{
+  samples_.clear();
+}
+
+bool TimingStats::isEmpty() const
+{
+  return samples_.isEmpty();
+}
+
+qint64 TimingStats::percentile(int p) const
+{
+  if(samples_.isEmpty()) return 0;
+
+  QVector<qint64> sorted = samples_;
+  std::sort(sorted.begin(), sorted.end());
+
+  return sorted[std::min(sorted.size() - 1, sorted.size() * p / 100)];
+}
+
+void TimingStats::report(const char* name) const
+{
+  if(samples_.isEmpty()) return;
+
+  qint64 total = 0;
+  for(auto sample: samples_) total += sample;
+
+  std::cerr << name << ": avg " << total / samples_.size() / 1000000.0 << " ms"
+            << ", p95 " << percentile(95) / 1000000.0 << " ms"
+            << ", max " << percentile(100) / 1000000.0 << " ms"
+            << " (" << samples_.size() << " samples)" << std::endl;
+}
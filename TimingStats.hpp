@@ -0,0 +1,17 @@
+#ifndef TIMINGSTATS_H
+#define TIMINGSTATS_H
+#include <QVector>
+
+class TimingStats
+{
+public:
+  void add(qint64 nsec);
+  void clear();
+  bool isEmpty() const;
+  qint64 percentile(int p) const;
+  void report(const char* name) const;
+
+private:
+  QVector<qint64> samples_;
+};
+#endif /* TIMINGSTATS_H */
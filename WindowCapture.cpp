@@ -0,0 +1,132 @@
+#include <QX11Info>
+#include <cstring>
+#include <cstdio>
+
+#include "WindowCapture.hpp"
+#include "PixelFormat.hpp"
+
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+#include <X11/extensions/Xcomposite.h>
+
+namespace {
+  int ignoreError(Display*, XErrorEvent*)
+  {
+    return 0;
+  }
+
+  // The composite pixmap belongs to the top-level window, the child of the
+  // root that the window manager may have wrapped around the client.
+  Window topLevel(Display* display, Window window)
+  {
+    Window root, parent;
+    Window* children;
+    unsigned int count;
+
+    for(;;) {
+      if(!XQueryTree(display, window, &root, &parent, &children, &count)) return 0;
+      if(children != 0) XFree(children);
+
+      if(parent == root || parent == 0) return window;
+      window = parent;
+    }
+  }
+}
+
+WindowCapture::WindowCapture(unsigned long window)
+  : window_(window), top_(0), needsRedraw_(false)
+{
+  Display* display = QX11Info::display();
+  int event, error, major = 0, minor = 2;
+
+  if(display == 0 || window == 0 ||
+     !XCompositeQueryExtension(display, &event, &error) ||
+     !XCompositeQueryVersion(display, &major, &minor) || (major == 0 && minor < 2))
+    return;
+
+  auto oldHandler = XSetErrorHandler(ignoreError);
+  Window top = topLevel(display, window);
+  XWindowAttributes attr;
+
+  if(top != 0 && XGetWindowAttributes(display, top, &attr) && attr.map_state == IsViewable) {
+    // Automatic redirection leaves the screen as it is and is a no-op when
+    // a compositing manager already redirects the window.
+    XCompositeRedirectWindow(display, top, CompositeRedirectAutomatic);
+    XSync(display, False);
+    top_ = top;
+
+    // Without a compositing manager the window only now gets its own
+    // pixmap, and covered parts appear once the client has redrawn them.
+    char name[32];
+    snprintf(name, sizeof(name), "_NET_WM_CM_S%d", DefaultScreen(display));
+    needsRedraw_ = XGetSelectionOwner(display, XInternAtom(display, name, False)) == None;
+  }
+
+  XSetErrorHandler(oldHandler);
+}
+
+WindowCapture::~WindowCapture()
+{
+  if(top_ == 0) return;
+
+  Display* display = QX11Info::display();
+  auto oldHandler = XSetErrorHandler(ignoreError);
+  XCompositeUnredirectWindow(display, top_, CompositeRedirectAutomatic);
+  XSync(display, False);
+  XSetErrorHandler(oldHandler);
+}
+
+bool WindowCapture::isRedirected() const
+{
+  return top_ != 0;
+}
+
+bool WindowCapture::needsRedraw() const
+{
+  return needsRedraw_;
+}
+
+QImage WindowCapture::grab(QRect* geometry)
+{
+  if(top_ == 0) return QImage();
+
+  Display* display = QX11Info::display();
+  auto oldHandler = XSetErrorHandler(ignoreError);
+  QImage ret;
+  XWindowAttributes topAttr, attr;
+
+  if(XGetWindowAttributes(display, top_, &topAttr) && XGetWindowAttributes(display, window_, &attr)) {
+    Pixmap pixmap = XCompositeNameWindowPixmap(display, top_);
+    XSync(display, False);
+
+    // Only the picked window is kept, not the decorations around it.
+    int x = 0, y = 0, rootX = 0, rootY = 0;
+    Window child;
+    XTranslateCoordinates(display, window_, top_, 0, 0, &x, &y, &child);
+    XTranslateCoordinates(display, window_, topAttr.root, 0, 0, &rootX, &rootY, &child);
+
+    int w = qMin(attr.width, topAttr.width - x);
+    int h = qMin(attr.height, topAttr.height - y);
+
+    XImage* image = (pixmap != 0 && w > 0 && h > 0) ?
+      XGetImage(display, pixmap, x + topAttr.border_width, y + topAttr.border_width,
+                w, h, AllPlanes, ZPixmap) : 0;
+
+    if(image != 0 && image -> bits_per_pixel == 32 && image -> byte_order == LSBFirst) {
+      QImage img(image -> width, image -> height,
+                 topAttr.depth == 32 ? QImage::Format_ARGB32_Premultiplied : QImage::Format_RGB32);
+
+      for(int row = 0; row < image -> height; ++row)
+        std::memcpy(img.scanLine(row), image -> data + row * image -> bytes_per_line, image -> width * 4);
+
+      ret = PixelFormat::toCanonical(img, "window");
+      if(geometry != 0) *geometry = QRect(rootX, rootY, image -> width, image -> height);
+    }
+
+    if(image != 0) XDestroyImage(image);
+    if(pixmap != 0) XFreePixmap(display, pixmap);
+  }
+
+  XSetErrorHandler(oldHandler);
+  return ret;
+}
@@ -0,0 +1,23 @@
+#ifndef WINDOWCAPTURE_H
+#define WINDOWCAPTURE_H
+#include <QImage>
+#include <QRect>
+
+// Redirects the top-level window of a client for as long as it lives, so
+// its contents can be read even where other windows cover it.
+class WindowCapture
+{
+public:
+  WindowCapture(unsigned long window);
+  ~WindowCapture();
+
+  bool isRedirected() const;
+  bool needsRedraw() const;
+  QImage grab(QRect* geometry);
+
+private:
+  unsigned long window_;
+  unsigned long top_;
+  bool needsRedraw_;
+};
+#endif /* WINDOWCAPTURE_H */
@@ -17,28 +17,67 @@
 #include <QMimeData>
 #include <QPair>
 #include <QFileDialog>
+#include <QFileInfo>
 #include <QUndoCommand>
 #include <QMessageBox>
 #include <QDate>
 #include <QTime>
+#include <QElapsedTimer>
+#include <QStyleOptionGraphicsItem>
+#include <QCursor>
 #include <complex>
+#include <random>
+#include <QtMath>
 
 #include "TextInputDialog.hpp"
 #include "XRapture.hpp"
+#include "ItemSerializer.hpp"
+#include "Session.hpp"
+#include "Qoi.hpp"
+#include "TimingStats.hpp"
+#include "PixelFormat.hpp"
+#include "ImageCompare.hpp"
+#include "StreamIO.hpp"
+#include "Quantize.hpp"
+#include "AutoTrim.hpp"
+#include "MemoryStats.hpp"
+#include "ScrollStitcher.hpp"
+#include "FakeInput.hpp"
+#include "WindowCapture.hpp"
+#include "Resample.hpp"
+#include "TiledRender.hpp"
+#include "CachedTextItem.hpp"
+#include "ClipboardHistory.hpp"
+
+static const quint32 PIN_MAGIC = 0x5852504e; // "XRPN"
+static const quint32 PIN_VERSION = 2;
+static const qint64 JOURNAL_LIMIT = 4 * 1024 * 1024;
+
+int XRapture::hibernateTimeout_ = 60 * 60 * 1000;
+bool XRapture::trace_ = false;
+int XRapture::autoTrim_ = -1;
 
 class AddItemCommand : public QUndoCommand
 {
 public:
-  AddItemCommand(QGraphicsScene* scene, QGraphicsItem* item, QUndoCommand *parent = 0):
-    QUndoCommand(parent), scene_(scene), item_(item) {
+  AddItemCommand(XRapture* view, QGraphicsItem* item, QUndoCommand *parent = 0):
+    QUndoCommand(parent), view_(view), scene_(view -> scene()), item_(item) {
   }
 
   void undo() {
+    view_ -> journalRemove(item_);
     scene_ -> removeItem(item_);
+    view_ -> invalidateImage(item_ -> sceneBoundingRect());
   }
 
   void redo() {
     scene_ -> addItem(item_);
+    view_ -> invalidateImage(item_ -> sceneBoundingRect());
+    view_ -> journalAdd(item_);
+  }
+
+  const QGraphicsItem* item() const {
+    return item_;
   }
 
   ~AddItemCommand() {
@@ -46,6 +85,7 @@ public:
   }
 
 private:
+  XRapture* view_;
   QGraphicsScene* scene_;
   QGraphicsItem* item_;
 };
@@ -60,11 +100,17 @@ public:
   void undo() {
     *trans_ = oldTrans_;
     view_ -> calcTransform();
+    view_ -> journalTransform(trans_);
   }
 
   void redo() {
     *trans_ = newTrans_;
     view_ -> calcTransform();
+    view_ -> journalTransform(trans_);
+  }
+
+  bool reverts(const QTransform* trans, const QTransform& value) const {
+    return trans_ == trans && oldTrans_ == value;
   }
 
   ~TransformCommand() {
@@ -77,16 +123,85 @@ private:
   QTransform newTrans_;
 };
 
-QImage XRapture::applyEffect(const QPixmap& src, QGraphicsEffect *effect, const QRect& rect) const
+class CropCommand : public QUndoCommand
+{
+public:
+  CropCommand(XRapture* view, const QRect& rect, QUndoCommand *parent = 0):
+    QUndoCommand(parent), view_(view), rect_(rect) {
+    // Only the dropped margins are kept for undo, QOI compressed.
+    QImage image = PixelFormat::fromPixmap(view -> pixmap_ -> pixmap(), "crop");
+    size_ = image.size();
+
+    // Margins too large for QOI are kept as they are.
+    for(auto& margin: margins(size_, rect_)) {
+      QImage part = image.copy(margin);
+      margins_ << Qoi::encode(part);
+      rawMargins_ << (margins_.last().isEmpty() ? part : QImage());
+    }
+  }
+
+  void undo() {
+    QImage image(size_, PixelFormat::CANONICAL);
+    QPainter painter(&image);
+    painter.setCompositionMode(QPainter::CompositionMode_Source);
+    painter.drawPixmap(rect_.topLeft(), view_ -> pixmap_ -> pixmap());
+
+    auto rects = margins(size_, rect_);
+    for(int i = 0; i < rects.size(); ++i)
+      painter.drawImage(rects[i].topLeft(), margins_[i].isEmpty() ? rawMargins_[i] : Qoi::decode(margins_[i]));
+    painter.end();
+
+    view_ -> applyCrop(PixelFormat::toPixmap(image, "crop"), -rect_.topLeft());
+  }
+
+  void redo() {
+    QPixmap kept = view_ -> pixmap_ -> pixmap().copy(rect_);
+    view_ -> applyCrop(kept, rect_.topLeft());
+  }
+
+  qint64 bytes() const {
+    qint64 ret = 0;
+    for(auto& margin: margins_) ret += margin.size();
+    for(auto& margin: rawMargins_) ret += MemoryStats::imageBytes(margin);
+    return ret;
+  }
+
+  ~CropCommand() {
+  }
+
+private:
+  static QVector<QRect> margins(const QSize& size, const QRect& rect) {
+    QVector<QRect> ret;
+    QRect candidates[] = {
+      QRect(0, 0, size.width(), rect.top()),
+      QRect(0, rect.bottom() + 1, size.width(), size.height() - rect.bottom() - 1),
+      QRect(0, rect.top(), rect.left(), rect.height()),
+      QRect(rect.right() + 1, rect.top(), size.width() - rect.right() - 1, rect.height()),
+    };
+
+    for(auto& candidate: candidates)
+      if(!candidate.isEmpty()) ret << candidate;
+    return ret;
+  }
+
+  XRapture* view_;
+  QRect rect_;
+  QSize size_;
+  QVector<QByteArray> margins_;
+  QVector<QImage> rawMargins_;
+};
+
+QImage XRapture::applyEffect(const QImage& src, QGraphicsEffect *effect, const QRect& rect) const
 {
   QGraphicsScene scene;
   QGraphicsPixmapItem item;
 
-  item.setPixmap(src);
+  item.setPixmap(PixelFormat::toPixmap(src, "blur"));
   item.setGraphicsEffect(effect);
   scene.addItem(&item);
 
-  QImage ret(QSize(rect.width(), rect.height()), QImage::Format_ARGB32);
+  QImage ret(QSize(rect.width(), rect.height()), PixelFormat::CANONICAL);
+  ret.fill(Qt::transparent);
   QPainter painter(&ret);
 
   scene.render(&painter, QRect(), rect);
@@ -180,11 +295,40 @@ QPainterPath XRapture::CreateArrow2(const QPointF& p1, const QPointF& p2, int wi
 
 XRapture::XRapture(QGraphicsScene* scene)
   : QGraphicsView(scene), titleBar_(false), textMode_(false), zoomScale_(100),
-    undoStack_(new QUndoStack), color_(Qt::red), lineWidth_(4), highlighter_(false),
-    pixmap_(0), preDrawItem_(0), oldButton_(Qt::NoButton), oldX_(0), oldY_(0),
-    drawMode_(DrawMode::FREE_LINE)
+    undoStack_(new QUndoStack(this)), color_(Qt::red), lineWidth_(4), highlighter_(false),
+    pixmap_(0), preDrawItem_(0), sceneVersion_(0), imageCacheValid_(false),
+    transformedVersion_(0), changedPixels_(0), onionOpacity_(0),
+    predictiveStroke_(false), exportAtZoom_(false), inspector_(false), trackingBeforeInspector_(false),
+    inspectPos_(-1, -1), regionStatsKey_(0), inputPending_(false), inputTime_(0),
+    frameTimer_(new QTimer(this)), pendingShape_(false),
+    oldButton_(Qt::NoButton), oldX_(0), oldY_(0),
+    saveTimer_(new QTimer(this)), imageDirty_(false), idleTimer_(new QTimer(this)),
+    journal_(new Journal(this)), replaying_(false),
+    hibernated_(false), grabBits_(0), grabBytes_(0), paletteMode_(PaletteMode::PALETTE_OFF), drawMode_(DrawMode::FREE_LINE)
 {
   this -> setObjectName("XRapture");
+  scene -> setItemIndexMethod(QGraphicsScene::BspTreeIndex);
+
+  saveTimer_ -> setSingleShot(true);
+  saveTimer_ -> setInterval(500);
+  connect(saveTimer_, &QTimer::timeout, this, &XRapture::saveSession);
+
+  clock_.start();
+
+  frameTimer_ -> setSingleShot(true);
+  frameTimer_ -> setTimerType(Qt::PreciseTimer);
+  connect(frameTimer_, &QTimer::timeout, this,
+          [=] {
+            if(!pendingShape_) return;
+
+            this -> flushShape();
+            frameTimer_ -> start();
+          }
+          );
+
+  idleTimer_ -> setSingleShot(true);
+  connect(idleTimer_, &QTimer::timeout, this, &XRapture::hibernate);
+  this -> startIdleTimer();
 
   if(titleBar_) {
     this -> setWindowFlags(Qt::WindowStaysOnTopHint |
@@ -203,6 +347,17 @@ XRapture::XRapture(QGraphicsScene* scene)
   this -> setRenderHints( QPainter::Antialiasing | QPainter::HighQualityAntialiasing );
 }
 
+XRapture* XRapture::createPin()
+{
+  auto scene = new QGraphicsScene;
+  auto pin = new XRapture(scene);
+
+  scene -> setParent(pin);
+  pin -> setAttribute(Qt::WA_DeleteOnClose);
+
+  return pin;
+}
+
 void XRapture::changeWindowGeometry(int x, int y, int w, int h)
 {
   if(titleBar_) {
@@ -222,12 +377,76 @@ void XRapture::screenCapture(int x, int y, int w, int h)
   if(w % 2 != 0) ++w;
   if(h % 2 != 0) ++h;
 
-  this -> setPixmap(screen -> grabWindow(0, x, y, w, h));
+  QImage grab = PixelFormat::fromPixmap(screen -> grabWindow(0, x, y, w, h), "capture");
+
+  this -> beginCapture(PixelFormat::toPixmap(grab, "capture"), x, y);
+  this -> mSleep(300);
+  this -> endCapture(x, y, w, h);
+}
+
+bool XRapture::windowCapture(unsigned long window)
+{
+  QRect rect;
+  WindowCapture capture(window);
+  if(!capture.isRedirected()) return false;
+
+  // Without a compositing manager, let the client repaint its newly
+  // redirected window first; the event loop keeps running meanwhile.
+  if(capture.needsRedraw()) this -> mSleep(100);
+
+  QImage image = capture.grab(&rect);
+  if(image.isNull()) return false;
+
+  this -> beginCapture(PixelFormat::toPixmap(image, "capture"), rect.x(), rect.y());
+  this -> endCapture(rect.x(), rect.y(), rect.width(), rect.height());
+
+  return true;
+}
+
+void XRapture::scrollCapture(int x, int y, int w, int h, bool autoScroll)
+{
+  QScreen* screen = QGuiApplication::primaryScreen();
+  ScrollStitcher stitcher;
+  QElapsedTimer idle;
+
+  if(w % 2 != 0) ++w;
+  if(h % 2 != 0) ++h;
+
+  // Frames are grabbed until the content stops moving: a few frames with
+  // auto-scroll, longer while waiting for the user to scroll.
+  idle.start();
+  while(!stitcher.isFull()) {
+    if(autoScroll && stitcher.frames() > 0 && !FakeInput::scroll(QPoint(x + w / 2, y + h / 2), 3))
+      autoScroll = false;
+
+    this -> mSleep(120);
+    if(stitcher.addFrame(PixelFormat::fromPixmap(screen -> grabWindow(0, x, y, w, h), "capture")))
+      idle.restart();
+
+    int timeout = autoScroll ? 600 : (stitcher.frames() > 1) ? 1500 : 10000;
+    if(idle.elapsed() > timeout) break;
+  }
+
+  QImage image = stitcher.result();
+  if(trace_)
+    std::cerr << "scroll capture: " << stitcher.frames() << " frames, "
+              << image.height() << " rows" << std::endl;
+
+  this -> beginCapture(PixelFormat::toPixmap(image, "capture"), x, y);
+  this -> mSleep(300);
+  this -> endCapture(x, y, image.width(), image.height());
+}
+
+void XRapture::beginCapture(const QPixmap& pixmap, int x, int y)
+{
+  this -> setPixmap(pixmap);
   this -> setStyleSheet("#XRapture {background: transparent; border: none;}");
   this -> setGeometry(x, y, 1, 1);
   this -> show();
-  this -> mSleep(300);
+}
 
+void XRapture::endCapture(int x, int y, int w, int h)
+{
   if(titleBar_) {
     this -> changeWindowGeometry(x, y, w, h);
   }
@@ -235,6 +454,88 @@ void XRapture::screenCapture(int x, int y, int w, int h)
     this -> changeWindowGeometry(x - 1, y - 1, w, h);
     this -> setStyleSheet("#XRapture {background-color: white;}");
   }
+
+  if(autoTrim_ >= 0) this -> autoTrimAction();
+}
+
+void XRapture::applyCrop(const QPixmap& pixmap, const QPoint& offset)
+{
+  auto trans = this -> transform();
+  auto before = trans.mapRect(sceneRect()).topLeft();
+  auto after = trans.mapRect(QRectF(offset, QSizeF(pixmap.size()))).topLeft();
+
+  // Annotations keep their place on the image.
+  for(auto item: this -> scene() -> items()) {
+    if(item != pixmap_ && item -> parentItem() == 0) item -> moveBy(-offset.x(), -offset.y());
+  }
+
+  pixmap_ -> setPixmap(pixmap);
+  this -> scene() -> setSceneRect(0, 0, pixmap.width(), pixmap.height());
+  setSceneRect(0, 0, pixmap.width(), pixmap.height());
+
+  // Caches at the old size would keep the dropped pixels alive.
+  imageCache_ = QImage();
+  transformedCache_ = QImage();
+  inspectRect_ = QRect();
+  regionStats_ = RegionStats();
+  regionStatsKey_ = 0;
+  this -> invalidateImage();
+
+  // Keep the remaining pixels where they were on screen.
+  auto delta = (after - before).toPoint();
+  this -> move(this -> pos() + delta);
+
+  this -> calcTransform();
+  this -> scheduleSave(true);
+}
+
+static void releaseSharedGrab(void* info)
+{
+  delete static_cast<QImage*>(info);
+}
+
+void XRapture::captureRegions(QList<QRect> rects)
+{
+  QRect bounds;
+
+  for(auto& rect: rects) {
+    if(rect.width() % 2 != 0) rect.setWidth(rect.width() + 1);
+    if(rect.height() % 2 != 0) rect.setHeight(rect.height() + 1);
+    bounds |= rect;
+  }
+  if(bounds.isEmpty()) return;
+
+  QScreen* screen = QGuiApplication::primaryScreen();
+  QImage grab = PixelFormat::fromPixmap(screen -> grabWindow(0, bounds.x(), bounds.y(),
+                                                           bounds.width(), bounds.height()),
+                                        "capture");
+
+  QList<XRapture*> pins;
+
+  for(auto rect: rects) {
+    // Each pin views its region of the single grab in place. The grab stays
+    // alive until the last view is released, and any write detaches a copy.
+    QRect local = rect.translated(-bounds.topLeft()) & grab.rect();
+    const uchar* bits = grab.constBits() + local.y() * grab.bytesPerLine() + local.x() * 4;
+    QImage view(bits, local.width(), local.height(), grab.bytesPerLine(), grab.format(),
+                releaseSharedGrab, new QImage(grab));
+
+    // The view is canonical, so the raster pixmap adopts it without a
+    // conversion or a copy.
+    XRapture* pin = XRapture::createPin();
+    pin -> grabBits_ = grab.constBits();
+    pin -> grabBytes_ = qint64(grab.bytesPerLine()) * grab.height();
+    pin -> beginCapture(PixelFormat::toPixmap(std::move(view), "capture"), rect.x(), rect.y());
+    pins << pin;
+  }
+
+  if(pins.isEmpty()) return;
+  pins.first() -> mSleep(300);
+
+  for(int i = 0; i < pins.size(); ++i) {
+    auto rect = rects[i];
+    pins[i] -> endCapture(rect.x(), rect.y(), rect.width(), rect.height());
+  }
 }
 
 void XRapture::setPixmap(QPixmap pixmap)
@@ -254,8 +555,15 @@ void XRapture::setPixmap(QPixmap pixmap)
   this -> scene() -> setSceneRect(0, 0, w, h);
   setSceneRect(0, 0, w, h);
 
+  // Callers pass pixmaps made by PixelFormat::toPixmap, which are canonical.
   pixmap_ = this -> scene() -> addPixmap(pixmap);
   pixmap_ -> setTransformationMode(Qt::SmoothTransformation);
+  inspectRect_ = QRect();
+  regionStats_ = RegionStats();
+  regionStatsKey_ = 0;
+  this -> invalidateImage();
+
+  this -> scheduleSave(true);
 }
 
 void XRapture::createEditSubMenu(QMenu* menu)
@@ -285,6 +593,18 @@ void XRapture::createEditSubMenu(QMenu* menu)
 
   if(!mimeData -> hasImage()) action -> setDisabled(true);
 
+  // Only the thumbnails are shown; the chosen entry alone is decoded.
+  auto historyMenu = editMenu -> addMenu("Paste &History");
+  for(int i = 0; i < ClipboardHistory::count(); ++i) {
+    auto& entry = ClipboardHistory::entry(i);
+    action = historyMenu -> addAction(QIcon(PixelFormat::toPixmap(entry.thumbnail, "history")),
+                                      QString("&%1  %2 x %3").arg(i + 1).arg(entry.size.width()).arg(entry.size.height()));
+    connect(action, &QAction::triggered,
+            [=] { this -> openImage(ClipboardHistory::image(i)); }
+            );
+  }
+  if(ClipboardHistory::count() == 0) historyMenu -> setDisabled(true);
+
   editMenu -> addSeparator();
   action = editMenu -> addAction("&Undo");
   action -> setShortcut(QKeySequence(Qt::CTRL + Qt::Key_Z));
@@ -295,6 +615,9 @@ void XRapture::createEditSubMenu(QMenu* menu)
 
   connect(action, &QAction::triggered, this, &XRapture::undoAction);
   if(!undoStack_ -> canUndo()) action -> setDisabled(true);
+
+  action = editMenu -> addAction("Auto &Trim");
+  connect(action, &QAction::triggered, this, &XRapture::autoTrimAction);
 }
 
 void XRapture::createColorSubMenu(QMenu* menu)
@@ -364,7 +687,9 @@ void XRapture::createDrawSubMenu(QMenu* menu, QContextMenuEvent *event)
 
             if(dialog.exec() == QDialog::Accepted) {
               textMode_ = true;
-              QGraphicsSimpleTextItem* textItem = this -> scene() -> addSimpleText(dialog.getText(), dialog.getFont());
+              auto textItem = new CachedTextItem(dialog.getText());
+              textItem -> setFont(dialog.getFont());
+              this -> scene() -> addItem(textItem);
 
               QColor color = dialog.getColor();
               if(highlighter_) color.setAlpha(128);
@@ -396,6 +721,7 @@ void XRapture::createDrawSubMenu(QMenu* menu, QContextMenuEvent *event)
      qMakePair(QString("&Rect"), DrawMode::RECT),
      qMakePair(QString("&Fill Rect"), DrawMode::FILL_RECT),
      qMakePair(QString("&Blur Rect"), DrawMode::BLUR_RECT),
+     qMakePair(QString("&Crop"), DrawMode::CROP),
     };
 
   for(auto drawMode: drawModeMenus) {
@@ -407,6 +733,14 @@ void XRapture::createDrawSubMenu(QMenu* menu, QContextMenuEvent *event)
             [=] { drawMode_ = drawMode.second; }
             );
   }
+
+  draSubMenu -> addSeparator();
+  action = draSubMenu -> addAction("&Predictive Stroke");
+  action -> setCheckable(true);
+  action -> setChecked(predictiveStroke_);
+  connect(action, &QAction::triggered,
+          [=](bool set) { predictiveStroke_ = set; }
+          );
 }
 
 void XRapture::createTransformSubMenu(QMenu* menu)
@@ -432,6 +766,86 @@ void XRapture::createTransformSubMenu(QMenu* menu)
           );
 }
 
+void XRapture::createCompareSubMenu(QMenu* menu)
+{
+  QAction* action;
+  auto compareSubMenu = menu -> addMenu("Co&mpare");
+
+  action = compareSubMenu -> addAction("With &File...");
+  connect(action, &QAction::triggered,
+          [=] {
+            auto fileName = QFileDialog::getOpenFileName(this);
+            if(fileName.isEmpty()) return;
+
+            QImage img(fileName);
+            if(img.isNull())
+              QMessageBox::warning(this, "Warning", "Invalid Image: " + fileName);
+            else
+              this -> compareAction(img);
+          }
+          );
+
+  action = compareSubMenu -> addAction("With &Clipboard");
+  const QMimeData *mimeData = QApplication::clipboard() -> mimeData();
+  if(!mimeData -> hasImage()) action -> setDisabled(true);
+  connect(action, &QAction::triggered,
+          [=] {
+            const QMimeData *mimeData = QApplication::clipboard() -> mimeData();
+            if(mimeData -> hasImage())
+              this -> compareAction(qvariant_cast<QImage>(mimeData -> imageData()));
+          }
+          );
+
+  auto pinSubMenu = compareSubMenu -> addMenu("With &Pin");
+  int index = 0;
+  for(auto widget: QApplication::topLevelWidgets()) {
+    XRapture* pin = dynamic_cast<XRapture*>(widget);
+    if(pin == 0) continue;
+
+    ++index;
+    if(pin == this || pin -> pixmap_ == 0 || !pin -> isVisible()) continue;
+
+    auto size = pin -> sceneRect().size().toSize();
+    action = pinSubMenu -> addAction("Pin " + QString::number(index) + " (" +
+                                     QString::number(size.width()) + "x" +
+                                     QString::number(size.height()) + ")");
+    connect(action, &QAction::triggered,
+            [=] {
+              pin -> rehydrate();
+              this -> compareAction(PixelFormat::fromPixmap(pin -> pixmap_ -> pixmap(), "compare"));
+            }
+            );
+  }
+  if(pinSubMenu -> isEmpty()) pinSubMenu -> setDisabled(true);
+
+  compareSubMenu -> addSeparator();
+  auto onionSubMenu = compareSubMenu -> addMenu("&Onion Skin");
+  auto onionGroup = new QActionGroup(this);
+  const char* onionLabels[] = {"0", "25", "50", "75", "100"};
+  for(auto label: onionLabels) {
+    qreal opacity = atoi(label) / 100.0;
+    action = new QAction(label, this);
+    action -> setCheckable(true);
+    if(qAbs(onionOpacity_ - opacity) < 0.01) action -> setChecked(true);
+
+    connect(action, &QAction::triggered,
+            [=] {
+              onionOpacity_ = opacity;
+              this -> viewport() -> update();
+            }
+            );
+    onionGroup -> addAction(action);
+    onionSubMenu -> addAction(action);
+  }
+
+  action = compareSubMenu -> addAction("C&lear");
+  if(compareImage_.isNull()) {
+    onionSubMenu -> setDisabled(true);
+    action -> setDisabled(true);
+  }
+  connect(action, &QAction::triggered, this, &XRapture::clearCompareAction);
+}
+
 void XRapture::createOpacitySubMenu(QMenu* menu)
 {
   auto opacitySubMenu = menu -> addMenu("&Opacity");
@@ -446,6 +860,7 @@ void XRapture::createOpacitySubMenu(QMenu* menu)
     connect(action, &QAction::triggered,
             [=] {
               this -> setWindowOpacity(opacity);
+              this -> scheduleSave(false);
             }
             );
     opacityGroup -> addAction(action);
@@ -493,6 +908,14 @@ void XRapture::createZoomSubMenu(QMenu* menu)
 
     zoomSubMenu -> addAction(action);
   }
+
+  zoomSubMenu -> addSeparator();
+  auto action = zoomSubMenu -> addAction("&Export at Zoom");
+  action -> setCheckable(true);
+  action -> setChecked(exportAtZoom_);
+  connect(action, &QAction::triggered,
+          [=](bool set) { exportAtZoom_ = set; }
+          );
 }
 
 void XRapture::contextMenuEvent(QContextMenuEvent *event)
@@ -500,6 +923,8 @@ void XRapture::contextMenuEvent(QContextMenuEvent *event)
   QMenu menu(this);
   QAction* action;
 
+  this -> rehydrate();
+
   auto fileSubMenu = menu.addMenu("&File");
   action = fileSubMenu -> addAction("&Open");
   action -> setShortcut(QKeySequence(Qt::CTRL + Qt::Key_O));
@@ -521,6 +946,24 @@ void XRapture::contextMenuEvent(QContextMenuEvent *event)
   connect(action, &QAction::triggered,
           [=] { saveAction(); }
           );
+
+  fileSubMenu -> addSeparator();
+  auto paletteMenus =
+    {
+     qMakePair(QString("&Full Color PNG"), PaletteMode::PALETTE_OFF),
+     qMakePair(QString("&Palette PNG (Exact)"), PaletteMode::PALETTE_EXACT),
+     qMakePair(QString("Palette PNG (&Dithered)"), PaletteMode::PALETTE_DITHER),
+    };
+
+  for(auto paletteMode: paletteMenus) {
+    action = fileSubMenu -> addAction(paletteMode.first);
+    action -> setCheckable(true);
+    if(paletteMode_ == paletteMode.second) action -> setChecked(true);
+
+    connect(action, &QAction::triggered,
+            [=] { paletteMode_ = paletteMode.second; }
+            );
+  }
   this -> createEditSubMenu(&menu);
 
   menu.addSeparator();
@@ -540,10 +983,27 @@ void XRapture::contextMenuEvent(QContextMenuEvent *event)
 
   this -> createDrawSubMenu(&menu, event);
   this -> createTransformSubMenu(&menu);
+  this -> createCompareSubMenu(&menu);
   menu.addSeparator();
 
   this -> createOpacitySubMenu(&menu);
   this -> createZoomSubMenu(&menu);
+  action = menu.addAction("&Inspector");
+  action -> setCheckable(true);
+  action -> setChecked(inspector_);
+  action -> setShortcut(QKeySequence(Qt::Key_I));
+
+#if QT_VERSION >= QT_VERSION_CHECK(5, 10, 0)
+  action -> setShortcutVisibleInContextMenu(true);
+#endif
+
+  connect(action, &QAction::triggered,
+          [=](bool set) { inspectorAction(set); }
+          );
+  action = menu.addAction("&Stats...");
+  connect(action, &QAction::triggered,
+          [=] { QMessageBox::information(this, "Stats", this -> memoryReport() + "\n" + sharedMemoryReport()); }
+          );
   action = menu.addAction("&ReCapture");
   connect(action, &QAction::triggered,
           [=] { reCaptureAction(); }
@@ -554,8 +1014,60 @@ void XRapture::contextMenuEvent(QContextMenuEvent *event)
   menu.exec(event -> globalPos());
 }
 
+void XRapture::moveEvent(QMoveEvent *event)
+{
+  QGraphicsView::moveEvent(event);
+  this -> scheduleSave(false);
+}
+
+void XRapture::enterEvent(QEvent *event)
+{
+  QGraphicsView::enterEvent(event);
+  this -> rehydrate();
+}
+
+void XRapture::leaveEvent(QEvent *event)
+{
+  QGraphicsView::leaveEvent(event);
+  if(inspector_) {
+    inspectPos_ = QPoint(-1, -1);
+    this -> viewport() -> update();
+  }
+  this -> startIdleTimer();
+}
+
+void XRapture::focusInEvent(QFocusEvent *event)
+{
+  QGraphicsView::focusInEvent(event);
+  this -> rehydrate();
+}
+
+void XRapture::focusOutEvent(QFocusEvent *event)
+{
+  QGraphicsView::focusOutEvent(event);
+  this -> startIdleTimer();
+}
+
+void XRapture::paintEvent(QPaintEvent *event)
+{
+  if(hibernated_) {
+    QPainter painter(this -> viewport());
+    painter.drawPixmap(0, 0, displayCache_);
+    return;
+  }
+
+  QGraphicsView::paintEvent(event);
+
+  if(trace_ && inputPending_) {
+    std::cerr << "latency: input-to-paint "
+              << (clock_.nsecsElapsed() - inputTime_) / 1000000.0 << " ms" << std::endl;
+    inputPending_ = false;
+  }
+}
+
 void XRapture::keyPressEvent(QKeyEvent *event)
 {
+  this -> rehydrate();
   QWidget::keyPressEvent(event);
 
   if(event->isAutoRepeat()) return;
@@ -595,6 +1107,9 @@ void XRapture::keyPressEvent(QKeyEvent *event)
     zoomScale_ = 500;
     this -> zoomAction(zoomScale_ / 100.0);
     break;
+  case Qt::Key_I:
+    this -> inspectorAction(!inspector_);
+    break;
   }
 
   return;
@@ -602,6 +1117,7 @@ void XRapture::keyPressEvent(QKeyEvent *event)
 
 void XRapture::mousePressEvent(QMouseEvent* event)
 {
+  this -> rehydrate();
   QGraphicsView::mousePressEvent(event);
 
   if(!textMode_) {
@@ -610,11 +1126,11 @@ void XRapture::mousePressEvent(QMouseEvent* event)
     oldX_ = event -> x();
     oldY_ = event -> y();
 
-    if(preDrawItem_ != 0) {
-      this -> scene() -> removeItem(preDrawItem_);
-      auto addItemCommand = new AddItemCommand(this -> scene(), preDrawItem_);
-      undoStack_ -> push(addItemCommand);
-      preDrawItem_ = 0;
+    this -> commitPreDrawItem();
+
+    if(inspector_ && oldButton_ == Qt::LeftButton && oldMouseModifiers_ == Qt::NoModifier) {
+      inspectRect_ = QRect();
+      this -> viewport() -> update();
     }
   }
   else {
@@ -622,11 +1138,7 @@ void XRapture::mousePressEvent(QMouseEvent* event)
     if(items.size() == 0) {
       preDrawItem_ -> setFlags({});
 
-      this -> scene() -> removeItem(preDrawItem_);
-      auto addItemCommand = new AddItemCommand(this -> scene(), preDrawItem_);
-      undoStack_ -> push(addItemCommand);
-
-      preDrawItem_ = 0;
+      this -> commitPreDrawItem();
       textMode_ = false;
     }
   }
@@ -639,23 +1151,14 @@ void XRapture::mouseReleaseEvent(QMouseEvent* event)
     oldX_ = event -> x();
     oldY_ = event -> y();
 
-    if(preDrawItem_ != 0) {
-      this -> scene() -> removeItem(preDrawItem_);
-      auto addItemCommand = new AddItemCommand(this -> scene(), preDrawItem_);
-      undoStack_ -> push(addItemCommand);
-      preDrawItem_ = 0;
-    }
+    this -> commitPreDrawItem();
   }
   else {
     auto items = this -> scene() -> selectedItems();
     if(items.size() == 0) {
       preDrawItem_ -> setFlags({});
 
-      this -> scene() -> removeItem(preDrawItem_);
-      auto addItemCommand = new AddItemCommand(this -> scene(), preDrawItem_);
-      undoStack_ -> push(addItemCommand);
-
-      preDrawItem_ = 0;
+      this -> commitPreDrawItem();
       textMode_ = false;
     }
   }
@@ -664,6 +1167,16 @@ void XRapture::mouseReleaseEvent(QMouseEvent* event)
 
 void XRapture::mouseMoveEvent(QMouseEvent* event)
 {
+  if(trace_ && !inputPending_) {
+    inputTime_ = clock_.nsecsElapsed();
+    inputPending_ = true;
+  }
+
+  if(inspector_) {
+    inspectPos_ = event -> pos();
+    this -> viewport() -> update();
+  }
+
   if(oldButton_ == Qt::MiddleButton) {
     int dx = oldX_ - event -> x();
     int dy = oldY_ - event -> y();
@@ -678,7 +1191,20 @@ void XRapture::mouseMoveEvent(QMouseEvent* event)
     oldY_ = event -> y();
   }
   if(oldButton_ == Qt::LeftButton) {
-    if(oldMouseModifiers_ == Qt::NoButton) {
+    // While inspecting, a plain drag selects the region to measure instead
+    // of moving the window.
+    if(oldMouseModifiers_ == Qt::NoButton && inspector_) {
+      auto p1 = mapToScene(QPoint(oldX_, oldY_));
+      auto p2 = mapToScene(event -> pos());
+      QRect rect = QRect(QPoint(qFloor(p1.x()), qFloor(p1.y())),
+                         QPoint(qFloor(p2.x()), qFloor(p2.y()))).normalized() & this -> sceneRect().toRect();
+
+      if(rect != inspectRect_) {
+        inspectRect_ = rect;
+        inspectResult_ = this -> regionStats().query(rect);
+      }
+    }
+    else if(oldMouseModifiers_ == Qt::NoButton) {
       auto gpos = event -> globalPos();
       auto geometry = this -> geometry();
 
@@ -704,21 +1230,13 @@ void XRapture::mouseMoveEvent(QMouseEvent* event)
         break;
 
       case LINE:
-        this -> drawLine(oldPoint, point, pen);
-        break;
-
       case ARROW1:
       case ARROW2:
-        this -> drawArrow(oldPoint, point, pen);
-        break;
-
       case RECT:
       case FILL_RECT:
-        this -> drawRect(oldPoint, point, pen);
-        break;
-
       case BLUR_RECT:
-        this -> drawBlurRect(oldPoint, point);
+      case CROP:
+        this -> queueShape(oldPoint, point, pen);
         break;
       }
     }
@@ -727,6 +1245,150 @@ void XRapture::mouseMoveEvent(QMouseEvent* event)
   QGraphicsView::mouseMoveEvent(event);
 }
 
+void XRapture::queueShape(const QPointF& p1, const QPointF& p2, const QPen& pen)
+{
+  pendingShape_ = true;
+  pendingP1_ = p1;
+  pendingP2_ = p2;
+  pendingPen_ = pen;
+
+  // The first move of a frame is drawn at once; later moves in the same
+  // frame only replace the pending end point, drawn when the frame ends.
+  if(!frameTimer_ -> isActive()) {
+    this -> flushShape();
+
+    qreal refreshRate = QGuiApplication::primaryScreen() -> refreshRate();
+    frameTimer_ -> start(qRound(1000 / (refreshRate > 0 ? refreshRate : 60)));
+  }
+}
+
+void XRapture::flushShape()
+{
+  if(!pendingShape_) return;
+  pendingShape_ = false;
+
+  switch (drawMode_) {
+  case LINE:
+    this -> drawLine(pendingP1_, pendingP2_, pendingPen_);
+    break;
+
+  case ARROW1:
+  case ARROW2:
+    this -> drawArrow(pendingP1_, pendingP2_, pendingPen_);
+    break;
+
+  case RECT:
+  case FILL_RECT:
+  case CROP:
+    this -> drawRect(pendingP1_, pendingP2_, pendingPen_);
+    break;
+
+  case BLUR_RECT:
+    this -> drawBlurRect(pendingP1_, pendingP2_);
+    break;
+
+  default:
+    break;
+  }
+}
+
+void XRapture::commitPreDrawItem()
+{
+  this -> flushShape();
+  frameTimer_ -> stop();
+
+  if(preDrawItem_ == 0) return;
+
+  if(drawMode_ == CROP && preDrawItem_ -> type() == QGraphicsRectItem::Type) {
+    auto item = static_cast<QGraphicsRectItem*>(preDrawItem_);
+    QRect rect = item -> rect().toAlignedRect() & this -> sceneRect().toRect();
+
+    this -> updatePreDrawItem(item -> sceneBoundingRect());
+    delete preDrawItem_;
+    preDrawItem_ = 0;
+
+    if(rect.width() > 1 && rect.height() > 1 && rect != this -> sceneRect().toRect())
+      undoStack_ -> push(new CropCommand(this, rect));
+    return;
+  }
+
+  if(preDrawItem_ -> scene() != 0)
+    this -> scene() -> removeItem(preDrawItem_);
+
+  auto addItemCommand = new AddItemCommand(this, preDrawItem_);
+  undoStack_ -> push(addItemCommand);
+  preDrawItem_ = 0;
+
+  strokeSamples_.clear();
+  if(!predictedTail_.isEmpty()) {
+    this -> updatePreDrawItem(predictedTail_.boundingRect());
+    predictedTail_.clear();
+  }
+}
+
+void XRapture::updatePreDrawItem(const QRectF& rect)
+{
+  qreal margin = lineWidth_ + 2;
+  this -> updateScene(QList<QRectF>() << rect.adjusted(-margin, -margin, margin, margin));
+}
+
+void XRapture::drawForeground(QPainter* painter, const QRectF& rect)
+{
+  QGraphicsView::drawForeground(painter, rect);
+
+  if(!compareImage_.isNull()) {
+    if(onionOpacity_ > 0) {
+      painter -> save();
+      painter -> setOpacity(onionOpacity_);
+      painter -> drawImage(0, 0, compareImage_);
+      painter -> restore();
+    }
+
+    painter -> drawImage(0, 0, compareHeatmap_);
+
+    QPen pen(Qt::cyan);
+    pen.setCosmetic(true);
+    painter -> save();
+    painter -> setPen(pen);
+    painter -> setBrush(Qt::NoBrush);
+    for(auto region: compareRegions_) painter -> drawRect(region);
+
+    QString summary = QString::number(changedPixels_) + " px changed, " +
+      QString::number(compareRegions_.size()) + " regions";
+    if(compareImage_.size() != this -> sceneRect().size().toSize())
+      summary += QString(", size %1x%2 vs %3x%4").arg(compareImage_.width()).arg(compareImage_.height())
+        .arg(this -> sceneRect().width()).arg(this -> sceneRect().height());
+    painter -> resetTransform();
+    QRect textRect = painter -> fontMetrics().boundingRect(summary).adjusted(-4, -2, 4, 2);
+    textRect.moveTopLeft(QPoint(4, 4));
+    painter -> fillRect(textRect, QColor(0, 0, 0, 160));
+    painter -> setPen(Qt::white);
+    painter -> drawText(textRect, Qt::AlignCenter, summary);
+    painter -> restore();
+  }
+
+  // The live shape is kept out of the scene (and its index) until it is
+  // committed, so it is painted here on top of the indexed items.
+  if(preDrawItem_ != 0 && preDrawItem_ -> scene() == 0) {
+    QStyleOptionGraphicsItem option;
+    option.exposedRect = preDrawItem_ -> boundingRect();
+
+    painter -> save();
+    painter -> setTransform(preDrawItem_ -> sceneTransform(), true);
+    preDrawItem_ -> paint(painter, &option, this -> viewport());
+    painter -> restore();
+
+    if(!predictedTail_.isEmpty()) {
+      painter -> save();
+      painter -> setPen(static_cast<QGraphicsPathItem*>(preDrawItem_) -> pen());
+      painter -> drawPolyline(predictedTail_);
+      painter -> restore();
+    }
+  }
+
+  if(inspector_ && pixmap_ != 0) this -> drawInspector(painter);
+}
+
 void XRapture::drawFreeLine(const QPointF& p1, const QPointF& p2, const QPen& pen)
 {
   if (preDrawItem_ == 0) {
@@ -734,7 +1396,8 @@ void XRapture::drawFreeLine(const QPointF& p1, const QPointF& p2, const QPen& pe
     path.moveTo(p2.x(), p2.y());
     path.lineTo(p1.x(), p1.y());
 
-    auto item = this -> scene() -> addPath(path, pen);
+    auto item = new QGraphicsPathItem(path);
+    item -> setPen(pen);
     preDrawItem_ = item;
   }
   else {
@@ -746,13 +1409,50 @@ void XRapture::drawFreeLine(const QPointF& p1, const QPointF& p2, const QPen& pe
 
     item -> setPath(path);
   }
+
+  this -> updatePreDrawItem(QRectF(p1, p2).normalized());
+  if(predictiveStroke_) this -> predictStroke(p2);
 }
 
-QLineF XRapture::snapLine(const QPointF& p1, const QPointF& p2) const
+void XRapture::predictStroke(const QPointF& point)
 {
-  QLineF line(p1, p2);
+  QRectF oldRect = predictedTail_.boundingRect();
+
+  strokeSamples_.push_back(qMakePair(point, clock_.nsecsElapsed()));
+  while(strokeSamples_.size() > 4) strokeSamples_.pop_front();
+
+  // Extrapolate one display frame ahead from the velocity of the last few
+  // samples; the tail is redrawn from scratch with every real sample.
+  predictedTail_.clear();
+  if(strokeSamples_.size() >= 2) {
+    auto first = strokeSamples_.first();
+    auto last = strokeSamples_.last();
+    qreal dt = (last.second - first.second) / 1e9;
+
+    if(dt > 0 && dt < 0.1) {
+      qreal refreshRate = QGuiApplication::primaryScreen() -> refreshRate();
+      qreal frame = 1.0 / (refreshRate > 0 ? refreshRate : 60);
+      QPointF velocity = (last.first - first.first) / dt;
+      QPointF ahead = velocity * frame;
+
+      qreal length = std::hypot(ahead.x(), ahead.y());
+      qreal maxLength = lineWidth_ * 4 + 32;
+      if(length > maxLength) ahead *= maxLength / length;
+
+      predictedTail_ << last.first;
+      for(int i = 1; i <= 3; ++i)
+        predictedTail_ << last.first + ahead * i / 3;
+    }
+  }
 
-  if(line.angle() > 88 && line.angle() < 92)
+  this -> updatePreDrawItem(oldRect.united(predictedTail_.boundingRect()));
+}
+
+QLineF XRapture::snapLine(const QPointF& p1, const QPointF& p2) const
+{
+  QLineF line(p1, p2);
+
+  if(line.angle() > 88 && line.angle() < 92)
     line.setLine(p1.x(), p1.y(), p1.x(), p2.y());
 
   if(line.angle() > 178 && line.angle() < 182)
@@ -770,32 +1470,44 @@ QLineF XRapture::snapLine(const QPointF& p1, const QPointF& p2) const
 void XRapture::drawLine(const QPointF& p1, const QPointF& p2, const QPen& pen)
 {
   if (preDrawItem_ == 0) {
-    preDrawItem_ = this -> scene() -> addLine(p2.x(), p2.y(), p1.x(), p1.y(), pen);
+    auto item = new QGraphicsLineItem(p2.x(), p2.y(), p1.x(), p1.y());
+    item -> setPen(pen);
+    preDrawItem_ = item;
+    this -> updatePreDrawItem(item -> sceneBoundingRect());
   }
   else {
     QGraphicsLineItem* item = static_cast<QGraphicsLineItem*>(preDrawItem_);
+    QRectF oldRect = item -> sceneBoundingRect();
 
     auto line = this -> snapLine(p1, p2);
     item -> setLine(line.x1(), line.y1(), line.x2(), line.y2());
+    this -> updatePreDrawItem(oldRect.united(item -> sceneBoundingRect()));
   }
 }
 
 void XRapture::drawArrow(const QPointF& p1, const QPointF& p2, const QPen& pen)
 {
   if (preDrawItem_ == 0) {
+    QGraphicsPathItem* item;
+
     if(drawMode_ == ARROW1) {
-      preDrawItem_ = this -> scene() -> addPath(CreateArrow(p1, p2, lineWidth_), pen);
+      item = new QGraphicsPathItem(CreateArrow(p1, p2, lineWidth_));
+      item -> setPen(pen);
     }
     else {
       QPen npen = pen;
       npen.setWidth(1);
 
-      preDrawItem_ = this -> scene() -> addPath(CreateArrow2(p1, p2, lineWidth_),
-                                        npen, QBrush(color_));
+      item = new QGraphicsPathItem(CreateArrow2(p1, p2, lineWidth_));
+      item -> setPen(npen);
+      item -> setBrush(QBrush(color_));
     }
+    preDrawItem_ = item;
+    this -> updatePreDrawItem(item -> sceneBoundingRect());
   }
   else {
     QGraphicsPathItem* item = static_cast<QGraphicsPathItem*>(preDrawItem_);
+    QRectF oldRect = item -> sceneBoundingRect();
 
     if(drawMode_ == ARROW1) {
       item -> setPath(CreateArrow(p1, p2, lineWidth_));
@@ -803,6 +1515,7 @@ void XRapture::drawArrow(const QPointF& p1, const QPointF& p2, const QPen& pen)
     else {
       item -> setPath(CreateArrow2(p1, p2, lineWidth_));
     }
+    this -> updatePreDrawItem(oldRect.united(item -> sceneBoundingRect()));
   }
 }
 
@@ -814,20 +1527,29 @@ void XRapture::drawRect(const QPointF& p1, const QPointF& p2, const QPen& pen)
   int h = std::abs(p1.y() - p2.y());
 
   if (preDrawItem_ == 0) {
+    auto item = new QGraphicsRectItem(x, y, w, h);
+
     if(drawMode_ == RECT)
-      preDrawItem_ = this -> scene() -> addRect(x, y, w, h,
-                                        pen);
+      item -> setPen(pen);
+    else if(drawMode_ == CROP) {
+      QPen npen(Qt::black, 0, Qt::DashLine);
+      item -> setPen(npen);
+    }
     else {
       QPen npen = pen;
       npen.setWidth(2);
-      preDrawItem_ = this -> scene() -> addRect(x, y, w, h,
-                                        npen, QBrush(color_));
+      item -> setPen(npen);
+      item -> setBrush(QBrush(color_));
     }
+    preDrawItem_ = item;
+    this -> updatePreDrawItem(item -> sceneBoundingRect());
   }
   else {
     QGraphicsRectItem* item = static_cast<QGraphicsRectItem*>(preDrawItem_);
+    QRectF oldRect = item -> sceneBoundingRect();
 
     item -> setRect(x, y, w, h);
+    this -> updatePreDrawItem(oldRect.united(item -> sceneBoundingRect()));
   }
 }
 
@@ -849,26 +1571,36 @@ void XRapture::drawBlurRect(QPointF p1, QPointF p2)
 
   if (preDrawItem_ == 0) {
     preDrawItem_ = new QGraphicsPixmapItem();
-    this -> scene() -> addItem(preDrawItem_);
   }
   QGraphicsPixmapItem* item = static_cast<QGraphicsPixmapItem*>(preDrawItem_);
+  QRectF oldRect = item -> sceneBoundingRect();
   item -> setPixmap(QPixmap(0, 0));
 
-  if (w == 0) return;
-  if (h == 0) return;
+  if (w == 0 || h == 0) {
+    this -> updatePreDrawItem(oldRect);
+    return;
+  }
+  const int radius = 12;
   QImage img = this -> getCurrentImage(false);
 
+  // Only the selection plus the reach of the blur kernel feeds the effect.
+  QRect area = QRect(x, y, w, h).adjusted(-radius * 2, -radius * 2, radius * 2, radius * 2) & img.rect();
+
   QGraphicsBlurEffect *blur = new QGraphicsBlurEffect;
-  blur -> setBlurRadius(12);
-  QPixmap pixmap = QPixmap::fromImage(applyEffect(QPixmap::fromImage(img),
-                                                  blur, QRect(x, y, w, h)));
+  blur -> setBlurRadius(radius);
+  QPixmap pixmap = PixelFormat::toPixmap(applyEffect(img.copy(area), blur,
+                                                     QRect(x - area.x(), y - area.y(), w, h)),
+                                         "blur");
 
   item -> setPos(x, y);
   item -> setPixmap(pixmap);
+  this -> updatePreDrawItem(oldRect.united(item -> sceneBoundingRect()));
 }
 
 void XRapture::wheelEvent(QWheelEvent *event)
 {
+  this -> rehydrate();
+
   if(event -> modifiers() == Qt::ControlModifier) {
     if(event -> angleDelta().y() > 0) {
       zoomScale_ += 10;
@@ -936,12 +1668,9 @@ void XRapture::reCaptureAction()
 
 bool XRapture::openImageFile(const QString fileName)
 {
-  QImage img(fileName);
+  QImage img = PixelFormat::toCanonical(QImage(fileName), "open");
   if(!img.isNull()) {
-    this -> setPixmap(QPixmap::fromImage(img));
-
-    auto rect = this -> geometry();
-    this -> changeWindowGeometry(rect.x(), rect.y(), img.width(), img.height());
+    this -> openImage(img);
     return true;
   }
   else {
@@ -950,15 +1679,209 @@ bool XRapture::openImageFile(const QString fileName)
   }
 }
 
+void XRapture::openImage(const QImage& img)
+{
+  this -> setPixmap(PixelFormat::toPixmap(img, "open"));
+
+  auto rect = this -> geometry();
+  this -> changeWindowGeometry(rect.x(), rect.y(), img.width(), img.height());
+}
+
+void XRapture::setOutput(const QString& target)
+{
+  output_ = target;
+}
+
+void XRapture::closeEvent(QCloseEvent *event)
+{
+  if(!output_.isEmpty() && pixmap_ != 0) {
+    this -> rehydrate();
+    StreamIO::writeImage(this -> exportImage(StreamIO::formatFor(output_)), output_);
+    output_.clear();
+  }
+
+  // A closed pin leaves the session; only pins still open when the process
+  // ends are restored.
+  saveTimer_ -> stop();
+  journal_ -> close();
+  if(!pinId_.isEmpty()) {
+    Session::remove(pinId_);
+    pinId_.clear();
+  }
+
+  QGraphicsView::closeEvent(event);
+}
+
 void XRapture::calcTransform()
 {
   this -> setTransform(scale_ * mirror_ * rotation_);
+  ++sceneVersion_;
 
   auto trans = transform();
   auto point = trans.map(QPoint(sceneRect().width(), sceneRect().height()));
   auto rect = this -> geometry();
 
   this -> changeWindowGeometry(rect.x(), rect.y(), std::abs(point.x()), std::abs(point.y()));
+  this -> scheduleSave(false);
+}
+
+void XRapture::compareAction(const QImage& other)
+{
+  if(pixmap_ == 0) return;
+
+  this -> rehydrate();
+  compareImage_ = PixelFormat::toCanonical(other, "compare");
+
+  auto result = ImageCompare::compare(PixelFormat::fromPixmap(pixmap_ -> pixmap(), "compare"),
+                                      compareImage_);
+  compareHeatmap_ = result.heatmap;
+  compareRegions_ = result.regions;
+  changedPixels_ = result.changedPixels;
+
+  this -> viewport() -> update();
+}
+
+void XRapture::clearCompareAction()
+{
+  compareImage_ = QImage();
+  compareHeatmap_ = QImage();
+  compareRegions_.clear();
+  changedPixels_ = 0;
+
+  this -> viewport() -> update();
+}
+
+void XRapture::autoTrimAction()
+{
+  if(pixmap_ == 0) return;
+
+  this -> rehydrate();
+  if(!textMode_) this -> commitPreDrawItem();
+
+  auto image = PixelFormat::fromPixmap(pixmap_ -> pixmap(), "trim");
+  QRect rect = AutoTrim::contentRect(image, autoTrim_ >= 0 ? autoTrim_ : 8);
+
+  if(rect.isValid() && rect != image.rect())
+    undoStack_ -> push(new CropCommand(this, rect));
+}
+
+void XRapture::inspectorAction(bool set)
+{
+  if(set == inspector_) return;
+
+  inspector_ = set;
+  inspectRect_ = QRect();
+  inspectPos_ = this -> viewport() -> mapFromGlobal(QCursor::pos());
+
+  if(set) {
+    trackingBeforeInspector_ = this -> viewport() -> hasMouseTracking();
+    this -> viewport() -> setMouseTracking(true);
+  }
+  else {
+    this -> viewport() -> setMouseTracking(trackingBeforeInspector_);
+    regionStats_ = RegionStats();
+    regionStatsKey_ = 0;
+  }
+  this -> viewport() -> update();
+}
+
+const RegionStats& XRapture::regionStats()
+{
+  // Built once per base image; queries after that scan at most the partial
+  // blocks along the edges of the region.
+  auto pixmap = pixmap_ -> pixmap();
+  if(pixmap.cacheKey() != regionStatsKey_) {
+    regionStats_.build(PixelFormat::fromPixmap(pixmap, "inspector"));
+    regionStatsKey_ = pixmap.cacheKey();
+  }
+
+  return regionStats_;
+}
+
+void XRapture::drawInspector(QPainter* painter)
+{
+  const int RADIUS = 7;
+  const int CELL = 9;
+  const QImage& image = this -> regionStats().image();
+  auto viewRect = this -> viewport() -> rect();
+
+  painter -> save();
+  if(!inspectRect_.isEmpty()) {
+    QPen pen(Qt::yellow);
+    pen.setCosmetic(true);
+    painter -> setPen(pen);
+    painter -> setBrush(Qt::NoBrush);
+    painter -> drawRect(inspectRect_);
+  }
+
+  painter -> resetTransform();
+  painter -> setRenderHint(QPainter::SmoothPixmapTransform, false);
+  auto fm = painter -> fontMetrics();
+
+  auto scenePos = mapToScene(inspectPos_);
+  QPoint pixel(qFloor(scenePos.x()), qFloor(scenePos.y()));
+
+  if(viewRect.contains(inspectPos_) && image.rect().contains(pixel)) {
+    int size = (RADIUS * 2 + 1) * CELL;
+    QRect loupe(inspectPos_ + QPoint(20, 20), QSize(size, size));
+    if(loupe.right() > viewRect.right()) loupe.moveRight(inspectPos_.x() - 20);
+    if(loupe.bottom() + fm.height() > viewRect.bottom()) loupe.moveBottom(inspectPos_.y() - 20 - fm.height());
+
+    painter -> fillRect(loupe, Qt::darkGray);
+    painter -> drawImage(loupe, image.copy(pixel.x() - RADIUS, pixel.y() - RADIUS, RADIUS * 2 + 1, RADIUS * 2 + 1));
+
+    QRect center(loupe.topLeft() + QPoint(RADIUS * CELL, RADIUS * CELL), QSize(CELL, CELL));
+    painter -> setPen(Qt::black);
+    painter -> drawRect(center.adjusted(-1, -1, 0, 0));
+    painter -> setPen(Qt::white);
+    painter -> drawRect(center.adjusted(0, 0, -1, -1));
+
+    QRgb px = qUnpremultiply(image.pixel(pixel));
+    QString label = QString("%1, %2  #%3  a %4")
+      .arg(pixel.x()).arg(pixel.y())
+      .arg(px & 0xffffff, 6, 16, QChar('0')).toUpper()
+      .arg(qAlpha(px));
+    QRect textRect(loupe.bottomLeft() + QPoint(0, 1), QSize(std::max(loupe.width(), fm.width(label) + 8), fm.height() + 4));
+    painter -> fillRect(textRect, QColor(0, 0, 0, 160));
+    painter -> drawText(textRect, Qt::AlignCenter, label);
+  }
+
+  if(!inspectRect_.isEmpty() && inspectResult_.count > 0) {
+    const char* names[] = { "R", "G", "B", "A" };
+    const QColor colors[] = { Qt::red, Qt::green, QColor(64, 128, 255) };
+    const int HIST_HEIGHT = 64;
+    auto& r = inspectResult_;
+
+    QStringList lines;
+    lines << QString("%1 x %2 = %3 px").arg(inspectRect_.width()).arg(inspectRect_.height()).arg(r.count);
+    for(int ch = 0; ch < 4; ++ch) {
+      lines << QString("%1  min %2  max %3  mean %4")
+        .arg(names[ch]).arg(r.min[ch], 3).arg(r.max[ch], 3).arg(r.mean[ch], 5, 'f', 1);
+    }
+
+    int width = 256;
+    for(auto& line: lines) width = std::max(width, fm.width(line));
+    QRect panel(4, 0, width + 8, lines.size() * fm.height() + HIST_HEIGHT + 12);
+    panel.moveBottom(viewRect.bottom() - 4);
+
+    painter -> fillRect(panel, QColor(0, 0, 0, 160));
+    painter -> setPen(Qt::white);
+    for(int i = 0; i < lines.size(); ++i)
+      painter -> drawText(panel.left() + 4, panel.top() + 4 + i * fm.height() + fm.ascent(), lines[i]);
+
+    quint32 peak = 1;
+    for(int i = 0; i < 3 * 256; ++i) peak = std::max(peak, r.histogram[i]);
+
+    int base = panel.bottom() - 4;
+    for(int ch = 0; ch < 3; ++ch) {
+      QPolygon polyline;
+      for(int v = 0; v < 256; ++v)
+        polyline << QPoint(panel.left() + 4 + v, base - int(qint64(r.histogram[ch * 256 + v]) * HIST_HEIGHT / peak));
+      painter -> setPen(colors[ch]);
+      painter -> drawPolyline(polyline);
+    }
+  }
+  painter -> restore();
 }
 
 void XRapture::undoAction()
@@ -971,9 +1894,10 @@ void XRapture::copyAction() const
   QClipboard *clipboard = QGuiApplication::clipboard();
   QMimeData *data = new QMimeData;
 
-  auto copyImg = this -> getCurrentImage();
+  auto copyImg = this -> exportImage();
   data -> setImageData(copyImg);
   clipboard -> setMimeData(data);
+  ClipboardHistory::add(copyImg);
 }
 
 void XRapture::pasteAction()
@@ -982,8 +1906,9 @@ void XRapture::pasteAction()
   const QMimeData *mimeData = clipboard -> mimeData();
 
   if(mimeData -> hasImage()) {
-    auto img = qvariant_cast<QPixmap>(mimeData -> imageData());
-    this -> setPixmap(img);
+    auto img = PixelFormat::toCanonical(qvariant_cast<QImage>(mimeData -> imageData()), "paste");
+    ClipboardHistory::add(img);
+    this -> setPixmap(PixelFormat::toPixmap(img, "paste"));
 
     auto rect = this -> geometry();
     this -> changeWindowGeometry(rect.x(), rect.y(), img.width(), img.height());
@@ -1006,14 +1931,398 @@ void XRapture::saveAction()
                                                QTime::currentTime().toString("hh-mm-ss") + ".png");
 
   if(!fileName.isEmpty()) {
-    auto saveImg = this -> getCurrentImage();
+    auto saveImg = this -> exportImage(QFileInfo(fileName).suffix().toLower().toLatin1());
     saveImg.save(fileName);
   }
 }
 
-void XRapture::quitAction() const
+void XRapture::quitAction()
+{
+  this -> close();
+}
+
+void XRapture::setHibernateTimeout(int msec)
+{
+  hibernateTimeout_ = msec;
+}
+
+void XRapture::startIdleTimer()
+{
+  if(hibernateTimeout_ <= 0 || hibernated_) return;
+  if(this -> underMouse() || this -> isActiveWindow()) return;
+
+  idleTimer_ -> start(hibernateTimeout_);
+}
+
+void XRapture::hibernate()
+{
+  if(hibernated_ || pixmap_ == 0 || preDrawItem_ != 0 || textMode_) return;
+  if(this -> underMouse() || this -> isActiveWindow()) return;
+
+  // Images too large for QOI stay awake.
+  QByteArray compressed = Qoi::encode(PixelFormat::fromPixmap(pixmap_ -> pixmap(), "hibernate"));
+  QByteArray compressedCompare = compareImage_.isNull() ? QByteArray() : Qoi::encode(compareImage_);
+  if(compressed.isEmpty() || (!compareImage_.isNull() && compressedCompare.isEmpty())) return;
+
+  if(saveTimer_ -> isActive()) {
+    saveTimer_ -> stop();
+    this -> saveSession();
+  }
+
+  // Keep what is on screen at display resolution and only a compressed copy
+  // of the source pixels; the full pixmap is rebuilt on the next interaction.
+  displayCache_ = this -> viewport() -> grab();
+  compressedPixmap_ = compressed;
+  pixmap_ -> setPixmap(QPixmap());
+  regionStats_ = RegionStats();
+  regionStatsKey_ = 0;
+
+  // Derived images are rebuilt on demand; the compare target is kept
+  // compressed and its heatmap recomputed.
+  imageCache_ = QImage();
+  imageCacheValid_ = false;
+  dirtyRegion_ = QRegion();
+  transformedCache_ = QImage();
+  compressedCompare_ = compressedCompare;
+  compareImage_ = QImage();
+  compareHeatmap_ = QImage();
+  hibernated_ = true;
+}
+
+void XRapture::rehydrate()
+{
+  idleTimer_ -> stop();
+  if(!hibernated_) return;
+
+  pixmap_ -> setPixmap(PixelFormat::toPixmap(Qoi::decode(compressedPixmap_), "rehydrate"));
+  compressedPixmap_.clear();
+  displayCache_ = QPixmap();
+  hibernated_ = false;
+
+  if(!compressedCompare_.isEmpty()) {
+    this -> compareAction(Qoi::decode(compressedCompare_));
+    compressedCompare_.clear();
+  }
+
+  this -> viewport() -> update();
+}
+
+QString XRapture::memoryReport() const
+{
+  MemoryStats stats;
+  QString ret;
+
+  if(hibernated_) {
+    auto rect = this -> sceneRect();
+    qint64 full = qint64(rect.width()) * rect.height() * 4;
+    qint64 held = compressedPixmap_.size() + MemoryStats::pixmapBytes(displayCache_);
+
+    ret += "State: hibernated (" + MemoryStats::kib(full - held) + " saved)\n";
+    stats.add("Compressed pixels", compressedPixmap_.size());
+    stats.add("Display cache", MemoryStats::pixmapBytes(displayCache_));
+    if(!compressedCompare_.isEmpty()) stats.add("Compressed compare image", compressedCompare_.size());
+  }
+  else if(pixmap_ != 0) {
+    // A view into the grab of --multi holds no pixels of its own.
+    const uchar* bits = PixelFormat::fromPixmap(pixmap_ -> pixmap(), "stats").constBits();
+    ret += "State: active\n";
+    if(grabBits_ != 0 && bits >= grabBits_ && bits < grabBits_ + grabBytes_) {
+      ret += "Base pixmap: view of a shared grab of " + MemoryStats::kib(grabBytes_) + "\n";
+      stats.add("Base pixmap (shared)", 0);
+    }
+    else {
+      stats.add("Base pixmap", MemoryStats::pixmapBytes(pixmap_ -> pixmap()));
+    }
+  }
+
+  for(auto item: this -> scene() -> items()) {
+    if(item != pixmap_) stats.addItem("Scene: ", item);
+  }
+  if(preDrawItem_ != 0 && preDrawItem_ -> scene() == 0) stats.addItem("Drawing: ", preDrawItem_);
+
+  // Items of undone commands are only reachable through the undo stack.
+  for(int i = 0; i < undoStack_ -> count(); ++i) {
+    auto command = undoStack_ -> command(i);
+
+    if(auto add = dynamic_cast<const AddItemCommand*>(command)) {
+      if(add -> item() -> scene() == 0) stats.addItem("Undo history: ", add -> item());
+    }
+    else if(auto crop = dynamic_cast<const CropCommand*>(command)) {
+      stats.add("Undo history: crops", crop -> bytes());
+    }
+  }
+
+  stats.add("Image cache", MemoryStats::imageBytes(imageCache_));
+  stats.add("Transformed cache", MemoryStats::imageBytes(transformedCache_));
+  stats.add("Inspector tables", regionStats_.bytes());
+  if(!compareImage_.isNull()) {
+    stats.add("Compare image", MemoryStats::imageBytes(compareImage_));
+    stats.add("Compare heatmap", MemoryStats::imageBytes(compareHeatmap_));
+  }
+
+  return ret + stats.report();
+}
+
+QString XRapture::sharedMemoryReport()
+{
+  MemoryStats stats;
+  auto clipboard = QApplication::clipboard();
+
+  // Clipboard data is held by this process only while it owns the selection.
+  if(clipboard -> ownsClipboard() && clipboard -> mimeData() -> hasImage())
+    stats.add("Clipboard image", MemoryStats::imageBytes(qvariant_cast<QImage>(clipboard -> mimeData() -> imageData())));
+
+  stats.add("Clipboard history", ClipboardHistory::bytes(), ClipboardHistory::count());
+
+  QString ret = stats.report();
+
+  auto conversions = PixelFormat::report();
+  if(!conversions.isEmpty())
+    ret += "\nPixel format conversions:\n" + conversions;
+
+  return ret;
+}
+
+void XRapture::dumpMemory()
+{
+  int index = 0;
+  for(auto widget: QApplication::topLevelWidgets()) {
+    XRapture* pin = dynamic_cast<XRapture*>(widget);
+    if(pin == 0) continue;
+
+    ++index;
+    std::cerr << "Pin " << index << ":\n" << pin -> memoryReport().toStdString() << std::endl;
+  }
+
+  std::cerr << "Process:\n" << sharedMemoryReport().toStdString() << std::endl;
+}
+
+void XRapture::setTrace(bool trace)
+{
+  trace_ = trace;
+}
+
+void XRapture::setAutoTrim(int tolerance)
+{
+  autoTrim_ = tolerance;
+}
+
+QByteArray XRapture::saveState() const
+{
+  QByteArray items;
+  QDataStream itemsOut(&items, QIODevice::WriteOnly);
+  itemsOut.setVersion(QDataStream::Qt_5_0);
+
+  qint32 count = 0;
+  for(auto item: this -> annotationItems()) {
+    if(ItemSerializer::write(itemsOut, item)) ++count;
+  }
+
+  QByteArray ret;
+  QDataStream out(&ret, QIODevice::WriteOnly);
+  out.setVersion(QDataStream::Qt_5_0);
+
+  out << PIN_MAGIC << PIN_VERSION << this -> geometry() << this -> windowOpacity()
+      << qint32(zoomScale_) << scale_ << mirror_ << rotation_ << quint64(journal_ -> sequence()) << count;
+  out.writeRawData(items.constData(), items.size());
+
+  return ret;
+}
+
+void XRapture::scheduleSave(bool imageChanged)
+{
+  if(!Session::isEnabled() || pixmap_ == 0) return;
+
+  if(imageChanged) imageDirty_ = true;
+  saveTimer_ -> start();
+}
+
+void XRapture::saveSession()
+{
+  if(pixmap_ == 0) return;
+
+  if(pinId_.isEmpty()) {
+    pinId_ = Session::newPinId();
+    imageDirty_ = true;
+  }
+
+  if(imageDirty_) {
+    if(!Session::saveImage(pinId_, PixelFormat::fromPixmap(pixmap_ -> pixmap(), "session"))) return;
+    imageDirty_ = false;
+  }
+
+  if(!journal_ -> isOpen()) journal_ -> open(Session::journalPath(pinId_), 0);
+  if(Session::saveState(pinId_, this -> saveState())) journal_ -> truncate();
+}
+
+QList<QGraphicsItem*> XRapture::annotationItems() const
+{
+  QList<QGraphicsItem*> ret;
+
+  for(auto item: this -> scene() -> items(Qt::AscendingOrder)) {
+    if(item != pixmap_ && item != preDrawItem_) ret << item;
+  }
+  return ret;
+}
+
+void XRapture::journal(quint8 op, const QByteArray& payload)
+{
+  if(!Session::isEnabled() || replaying_ || pixmap_ == 0) return;
+
+  // Until the base image is on disk a record has nothing to apply to, so
+  // checkpoint instead; the state then already holds this edit.
+  if(pinId_.isEmpty() || imageDirty_ || !journal_ -> isOpen()) {
+    saveTimer_ -> stop();
+    this -> saveSession();
+    return;
+  }
+
+  journal_ -> append(op, payload);
+  if(journal_ -> size() > JOURNAL_LIMIT) this -> scheduleSave(false);
+}
+
+void XRapture::journalAdd(QGraphicsItem* item)
+{
+  QByteArray payload;
+  QDataStream out(&payload, QIODevice::WriteOnly);
+  out.setVersion(QDataStream::Qt_5_0);
+
+  if(ItemSerializer::write(out, item)) this -> journal(Journal::ADD, payload);
+}
+
+void XRapture::journalRemove(QGraphicsItem* item)
+{
+  QByteArray payload;
+  QDataStream out(&payload, QIODevice::WriteOnly);
+  out << qint32(this -> annotationItems().indexOf(item));
+
+  this -> journal(Journal::REMOVE, payload);
+}
+
+void XRapture::journalTransform(const QTransform* trans)
+{
+  QByteArray payload;
+  QDataStream out(&payload, QIODevice::WriteOnly);
+  out.setVersion(QDataStream::Qt_5_0);
+  out << quint8(trans == &scale_ ? 0 : trans == &mirror_ ? 1 : 2) << *trans;
+
+  this -> journal(Journal::TRANSFORM, payload);
+}
+
+bool XRapture::replayJournal(const Journal::Record& record)
+{
+  QDataStream in(record.payload);
+  in.setVersion(QDataStream::Qt_5_0);
+
+  // Effects recorded after an undo are replayed as an undo when they match
+  // the top of the rebuilt stack, so the restored history stays usable.
+  auto top = undoStack_ -> index() > 0 ? undoStack_ -> command(undoStack_ -> index() - 1) : 0;
+
+  switch(record.op) {
+  case Journal::ADD: {
+    auto item = ItemSerializer::read(in);
+    if(item == 0) return false;
+
+    undoStack_ -> push(new AddItemCommand(this, item));
+    return true;
+  }
+  case Journal::REMOVE: {
+    qint32 index;
+    in >> index;
+
+    auto items = this -> annotationItems();
+    if(in.status() != QDataStream::Ok || index < 0 || index >= items.size()) return false;
+
+    auto add = dynamic_cast<const AddItemCommand*>(top);
+    if(add != 0 && add -> item() == items[index]) {
+      undoStack_ -> undo();
+    }
+    else {
+      this -> scene() -> removeItem(items[index]);
+      this -> invalidateImage();
+    }
+    return true;
+  }
+  case Journal::TRANSFORM: {
+    quint8 which;
+    QTransform value;
+    in >> which >> value;
+    if(in.status() != QDataStream::Ok || which > 2) return false;
+
+    QTransform* trans = (which == 0) ? &scale_ : (which == 1) ? &mirror_ : &rotation_;
+    auto transform = dynamic_cast<const TransformCommand*>(top);
+
+    if(transform != 0 && transform -> reverts(trans, value))
+      undoStack_ -> undo();
+    else
+      undoStack_ -> push(new TransformCommand(this, trans, *trans, value));
+    return true;
+  }
+  }
+
+  return false;
+}
+
+bool XRapture::restorePin(const QString& id)
 {
-  QApplication::quit();
+  QImage img = Session::loadImage(id);
+  QByteArray state = Session::loadState(id);
+  QDataStream in(state);
+  in.setVersion(QDataStream::Qt_5_0);
+
+  quint32 magic, version;
+  in >> magic >> version;
+  if(img.isNull() || in.status() != QDataStream::Ok ||
+     magic != PIN_MAGIC || version < 1 || version > PIN_VERSION) return false;
+
+  QRect geometry;
+  qreal opacity;
+  qint32 zoomScale, count;
+  QTransform scale, mirror, rotation;
+  quint64 seq = 0;
+  in >> geometry >> opacity >> zoomScale >> scale >> mirror >> rotation;
+  if(version >= 2) in >> seq;
+  in >> count;
+  if(in.status() != QDataStream::Ok) return false;
+
+  replaying_ = true;
+  this -> setPixmap(PixelFormat::toPixmap(img, "restore"));
+
+  for(int i = 0; i < count; ++i) {
+    auto item = ItemSerializer::read(in);
+    if(item == 0) break;
+
+    undoStack_ -> push(new AddItemCommand(this, item));
+  }
+
+  scale_ = scale;
+  mirror_ = mirror;
+  rotation_ = rotation;
+  zoomScale_ = zoomScale;
+
+  // Records up to the checkpoint are already part of the state.
+  int replayed = 0;
+  for(auto& record: Journal::read(Session::journalPath(id))) {
+    if(record.seq <= seq) continue;
+    if(!this -> replayJournal(record)) break;
+
+    seq = record.seq;
+    ++replayed;
+  }
+  replaying_ = false;
+
+  this -> setWindowOpacity(opacity);
+  this -> move(geometry.topLeft());
+  this -> calcTransform();
+
+  pinId_ = id;
+  imageDirty_ = false;
+  journal_ -> open(Session::journalPath(id), seq);
+
+  // Fold the replayed records into a new checkpoint.
+  if(replayed == 0) saveTimer_ -> stop();
+
+  return true;
 }
 
 void XRapture::mSleep(int msec) const
@@ -1023,16 +2332,199 @@ void XRapture::mSleep(int msec) const
   loop.exec();
 }
 
+void XRapture::invalidateImage()
+{
+  ++sceneVersion_;
+  imageCacheValid_ = false;
+  dirtyRegion_ = QRegion();
+}
+
+void XRapture::invalidateImage(const QRectF& rect)
+{
+  ++sceneVersion_;
+  if(imageCacheValid_)
+    dirtyRegion_ += rect.toAlignedRect().adjusted(-1, -1, 1, 1) & imageCache_.rect();
+}
+
+QImage XRapture::exportImage(const QByteArray& format) const
+{
+  QImage ret = this -> getCurrentImage();
+
+  if(exportAtZoom_) {
+    QSize size(qRound(ret.width() * std::abs(scale_.m11())), qRound(ret.height() * std::abs(scale_.m22())));
+    if(!size.isEmpty() && size != ret.size()) ret = Resample::scaled(ret, size);
+  }
+
+  if(paletteMode_ != PaletteMode::PALETTE_OFF && format == "png") {
+    // Exact keeps every pixel and falls back to full color past 256 colors.
+    auto indexed = (paletteMode_ == PaletteMode::PALETTE_EXACT) ?
+      Quantize::exact(ret) : Quantize::dithered(ret);
+    if(!indexed.isNull()) ret = indexed;
+  }
+
+  return PixelFormat::forExport(ret);
+}
+
+QImage XRapture::renderImage() const
+{
+  QRect rect = this -> sceneRect().toRect();
+  auto entries = TiledRender::snapshot(this -> scene(), rect);
+
+  // Small images are rendered as one tile.
+  int whole = std::max(rect.width(), rect.height());
+  int tileSize = (qint64(rect.width()) * rect.height() > 1024 * 1024) ? 512 : whole;
+
+  QElapsedTimer timer;
+  timer.start();
+  QImage img = TiledRender::render(entries, rect, tileSize);
+
+  if(trace_ && tileSize != whole) {
+    qint64 tiled = timer.nsecsElapsed();
+    timer.start();
+    QImage single = TiledRender::render(entries, rect, whole);
+
+    std::cerr << "render " << rect.width() << "x" << rect.height() << ": tiled "
+              << tiled / 1000000.0 << " ms, single " << timer.nsecsElapsed() / 1000000.0 << " ms, "
+              << (img == single ? "identical" : "DIFFERENT") << std::endl;
+  }
+
+  return img;
+}
+
 QImage XRapture::getCurrentImage(bool trans) const
+{
+  // An item still being edited inside the scene (text) is not tracked by the
+  // cache, so render it directly.
+  if(preDrawItem_ != 0 && preDrawItem_ -> scene() != 0) {
+    if(trans)
+      return this -> renderImage().transformed(mirror_ * rotation_);
+    else
+      return this -> renderImage();
+  }
+
+  auto size = this -> sceneRect().size().toSize();
+
+  if(!imageCacheValid_ || imageCache_.size() != size) {
+    imageCache_ = this -> renderImage();
+    imageCacheValid_ = true;
+    dirtyRegion_ = QRegion();
+  }
+  else if(!dirtyRegion_.isEmpty()) {
+    QPainter painter(&imageCache_);
+    painter.setRenderHints( QPainter::Antialiasing | QPainter::HighQualityAntialiasing );
+
+    auto rects = dirtyRegion_.rects();
+    if(rects.size() > 16) {
+      rects.clear();
+      rects << dirtyRegion_.boundingRect();
+    }
+
+    for(auto rect: rects) {
+      painter.setClipRect(rect);
+      painter.setCompositionMode(QPainter::CompositionMode_Source);
+      painter.fillRect(rect, Qt::transparent);
+      painter.setCompositionMode(QPainter::CompositionMode_SourceOver);
+      TiledRender::paint(&painter, TiledRender::snapshot(this -> scene(), rect), rect);
+    }
+    dirtyRegion_ = QRegion();
+  }
+
+  if(!trans) return imageCache_;
+
+  if(transformedVersion_ != sceneVersion_ || transformedCache_.isNull()) {
+    transformedCache_ = imageCache_.transformed(mirror_ * rotation_);
+    transformedVersion_ = sceneVersion_;
+  }
+  return transformedCache_;
+}
+
+void XRapture::runStressTest(int count)
 {
   auto rect = this -> sceneRect();
-  QImage img(rect.width(), rect.height(), QImage::Format_RGB32);
-  QPainter painter(&img);
-  painter.setRenderHints( QPainter::Antialiasing | QPainter::HighQualityAntialiasing );
-  this -> scene() -> render(&painter, rect, rect);
-
-  if(trans)
-    return img.transformed(mirror_ * rotation_);
-  else
-    return img;
+  std::mt19937 rng(1);
+  std::uniform_real_distribution<qreal> rx(0, rect.width());
+  std::uniform_real_distribution<qreal> ry(0, rect.height());
+  std::uniform_real_distribution<qreal> step(-20, 20);
+  QElapsedTimer timer;
+
+  timer.start();
+  for(int i = 0; i < count; ++i) {
+    QPointF p1(rx(rng), ry(rng));
+    QPointF p2(p1.x() + step(rng) * 5, p1.y() + step(rng) * 5);
+    QPen pen(QColor::fromHsv(i % 360, 255, 255));
+    pen.setCapStyle(Qt::RoundCap);
+    pen.setJoinStyle(Qt::RoundJoin);
+    pen.setWidth(lineWidth_);
+
+    QAbstractGraphicsShapeItem* shape = 0;
+    QGraphicsItem* item = 0;
+
+    switch(i % 5) {
+    case 0: {
+      QPainterPath path;
+      path.moveTo(p1);
+      for(int j = 0; j < 32; ++j)
+        path.lineTo(path.currentPosition() + QPointF(step(rng), step(rng)));
+      shape = new QGraphicsPathItem(path);
+      break;
+    }
+    case 1: {
+      auto line = new QGraphicsLineItem(QLineF(p1, p2));
+      line -> setPen(pen);
+      item = line;
+      break;
+    }
+    case 2:
+      shape = new QGraphicsPathItem(CreateArrow(p1, p2, lineWidth_));
+      break;
+    case 3:
+      shape = new QGraphicsRectItem(QRectF(p1, p2).normalized());
+      break;
+    case 4:
+      shape = new CachedTextItem(QString::number(i));
+      shape -> setPos(p1);
+      shape -> setBrush(pen.color());
+      break;
+    }
+    if(shape != 0) {
+      if(i % 5 != 4) shape -> setPen(pen);
+      item = shape;
+    }
+
+    undoStack_ -> push(new AddItemCommand(this, item));
+  }
+  std::cerr << "populate " << count << " items: "
+            << timer.nsecsElapsed() / 1000000.0 << " ms" << std::endl;
+
+  const int frames = 100;
+  TimingStats samples;
+
+  for(int i = 0; i < frames; ++i) {
+    timer.start();
+    this -> viewport() -> repaint();
+    samples.add(timer.nsecsElapsed());
+  }
+  samples.report("paint");
+
+  // Zoom the view without resizing the window so there is room to pan.
+  this -> setTransform(QTransform::fromScale(2, 2));
+  samples.clear();
+  for(int i = 0; i < frames; ++i) {
+    auto bar = this -> horizontalScrollBar();
+    timer.start();
+    bar -> setValue((i % 2 == 0) ? bar -> value() + 40 : bar -> value() - 20);
+    this -> viewport() -> repaint();
+    samples.add(timer.nsecsElapsed());
+  }
+  samples.report("pan");
+
+  this -> calcTransform();
+  samples.clear();
+  for(int i = 0; i < frames * 10; ++i) {
+    QPointF point(rx(rng), ry(rng));
+    timer.start();
+    auto items = this -> scene() -> items(point);
+    samples.add(timer.nsecsElapsed());
+  }
+  samples.report("hit-test");
 }
@@ -3,15 +3,27 @@
 #include <QMouseEvent>
 #include <QScreen>
 #include <QStack>
+#include <QElapsedTimer>
+
+#include "Journal.hpp"
+#include "RegionStats.hpp"
 
 class QUndoStack;
 class QMenu;
+class QTimer;
 class TransformCommand;
+class EventReplayer;
+class AddItemCommand;
+class CropCommand;
 class XRapture: public QGraphicsView
 {
 public:
   friend TransformCommand;
+  friend EventReplayer;
+  friend AddItemCommand;
+  friend CropCommand;
   XRapture(QGraphicsScene* scene);
+  static XRapture* createPin();
 
   void setPixmap(QPixmap pixmap);
   void keyPressEvent(QKeyEvent *event);
@@ -20,17 +32,38 @@ public:
   void mouseMoveEvent(QMouseEvent* event);
   void wheelEvent(QWheelEvent *event);
   void contextMenuEvent(QContextMenuEvent *event);
+  void moveEvent(QMoveEvent *event);
+  void enterEvent(QEvent *event);
+  void leaveEvent(QEvent *event);
+  void focusInEvent(QFocusEvent *event);
+  void focusOutEvent(QFocusEvent *event);
+  void paintEvent(QPaintEvent *event);
+  void closeEvent(QCloseEvent *event);
+  void drawForeground(QPainter* painter, const QRectF& rect);
   void screenCapture(int x, int y, int w, int h);
+  bool windowCapture(unsigned long window);
+  void scrollCapture(int x, int y, int w, int h, bool autoScroll);
+  static void captureRegions(QList<QRect> rects);
   void reCaptureAction();
   bool openImageFile(const QString fileName);
+  void openImage(const QImage& img);
+  void setOutput(const QString& target);
+  bool restorePin(const QString& id);
+  QString memoryReport() const;
+  static QString sharedMemoryReport();
+  static void dumpMemory();
+  static void setHibernateTimeout(int msec);
+  static void setTrace(bool trace);
+  static void setAutoTrim(int tolerance);
+  void runStressTest(int count);
 
 private:
-  QImage applyEffect(const QPixmap& src, QGraphicsEffect *effect, const QRect& rect) const;
+  QImage applyEffect(const QImage& src, QGraphicsEffect *effect, const QRect& rect) const;
   QPixmap CreateColorPixmap(const QColor& color) const;
   QPainterPath CreateArrow(const QPointF& p1, const QPointF& p2, int width) const;
   QPainterPath CreateArrow2(const QPointF& p1, const QPointF& p2, int width) const;
 
-  void quitAction() const;
+  void quitAction();
   void openAction();
   void saveAction();
   void zoomAction(qreal scale);
@@ -39,19 +72,48 @@ private:
   void undoAction();
   void copyAction() const;
   void pasteAction();
+  void compareAction(const QImage& other);
+  void clearCompareAction();
+  void autoTrimAction();
+  void inspectorAction(bool set);
 
   void createEditSubMenu(QMenu* menu);
   void createColorSubMenu(QMenu* menu);
   void createLineWidthSubMenu(QMenu* menu);
   void createDrawSubMenu(QMenu* menu, QContextMenuEvent *event);
   void createTransformSubMenu(QMenu* menu);
+  void createCompareSubMenu(QMenu* menu);
   void createOpacitySubMenu(QMenu* menu);
   void createZoomSubMenu(QMenu* menu);
 
   void calcTransform();
   void changeWindowGeometry(int x, int y, int w, int h);
+  void beginCapture(const QPixmap& pixmap, int x, int y);
+  void endCapture(int x, int y, int w, int h);
+  void applyCrop(const QPixmap& pixmap, const QPoint& offset);
+  const RegionStats& regionStats();
+  void drawInspector(QPainter* painter);
+
+  QByteArray saveState() const;
+  void scheduleSave(bool imageChanged);
+  void saveSession();
+  QList<QGraphicsItem*> annotationItems() const;
+  void journal(quint8 op, const QByteArray& payload);
+  void journalAdd(QGraphicsItem* item);
+  void journalRemove(QGraphicsItem* item);
+  void journalTransform(const QTransform* trans);
+  bool replayJournal(const Journal::Record& record);
 
+  void startIdleTimer();
+  void hibernate();
+  void rehydrate();
+
+  void commitPreDrawItem();
+  void updatePreDrawItem(const QRectF& rect);
   void drawFreeLine(const QPointF& p1, const QPointF& p2, const QPen& pen);
+  void predictStroke(const QPointF& point);
+  void queueShape(const QPointF& p1, const QPointF& p2, const QPen& pen);
+  void flushShape();
   void drawLine(const QPointF& p1, const QPointF& p2, const QPen& pen);
   void drawArrow(const QPointF& p1, const QPointF& p2, const QPen& pen);
   void drawRect(const QPointF& p1, const QPointF& p2, const QPen& pen);
@@ -60,6 +122,10 @@ private:
   QLineF snapLine(const QPointF& p1, const QPointF& p2) const;
   void mSleep(int msec) const;
   QImage getCurrentImage(bool trans = false) const;
+  QImage renderImage() const;
+  QImage exportImage(const QByteArray& format = QByteArray()) const;
+  void invalidateImage();
+  void invalidateImage(const QRectF& rect);
 
   bool titleBar_;
   bool textMode_;
@@ -73,9 +139,54 @@ private:
   bool highlighter_;
   QGraphicsPixmapItem* pixmap_;
   QGraphicsItem* preDrawItem_;
+  quint64 sceneVersion_;
+  mutable QImage imageCache_;
+  mutable bool imageCacheValid_;
+  mutable QRegion dirtyRegion_;
+  mutable QImage transformedCache_;
+  mutable quint64 transformedVersion_;
+  QImage compareImage_;
+  QImage compareHeatmap_;
+  QVector<QRect> compareRegions_;
+  qint64 changedPixels_;
+  qreal onionOpacity_;
+  bool predictiveStroke_;
+  bool exportAtZoom_;
+  bool inspector_;
+  bool trackingBeforeInspector_;
+  QPoint inspectPos_;
+  QRect inspectRect_;
+  RegionStats regionStats_;
+  qint64 regionStatsKey_;
+  RegionStats::Result inspectResult_;
+  QList<QPair<QPointF, qint64> > strokeSamples_;
+  QPolygonF predictedTail_;
+  QElapsedTimer clock_;
+  bool inputPending_;
+  qint64 inputTime_;
+  static bool trace_;
+  QTimer* frameTimer_;
+  bool pendingShape_;
+  QPointF pendingP1_, pendingP2_;
+  QPen pendingPen_;
   Qt::MouseButton oldButton_;
   Qt::KeyboardModifiers oldMouseModifiers_;
   int oldX_, oldY_;
+  QString pinId_;
+  QString output_;
+  QTimer* saveTimer_;
+  bool imageDirty_;
+  QTimer* idleTimer_;
+  Journal* journal_;
+  bool replaying_;
+  bool hibernated_;
+  QPixmap displayCache_;
+  const uchar* grabBits_;
+  qint64 grabBytes_;
+  QByteArray compressedPixmap_;
+  QByteArray compressedCompare_;
+  static int hibernateTimeout_;
+  static int autoTrim_;
 
   enum DrawMode {
     FREE_LINE,
@@ -85,6 +196,13 @@ private:
     RECT,
     FILL_RECT,
     BLUR_RECT,
+    CROP,
+  };
+  enum PaletteMode {
+    PALETTE_OFF,
+    PALETTE_EXACT,
+    PALETTE_DITHER,
   };
+  PaletteMode paletteMode_;
   DrawMode drawMode_;
 };
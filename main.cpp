@@ -1,17 +1,279 @@
 #include <QApplication>
+#include <QCommandLineParser>
+#include <QTimer>
+#include <QScreen>
+#include <QThread>
 #include <iostream>
+#include <signal.h>
 #include <slop.hpp>
 
 #include "XRapture.hpp"
+#include "Session.hpp"
+#include "EventRecorder.hpp"
+#include "StreamIO.hpp"
+#include "MemoryStats.hpp"
+#include "ImageLoader.hpp"
+#include "FolderWatcher.hpp"
 
 int main(int argc, char** argv)
 {
+  QApplication app(argc, argv);
+  app.setApplicationName("xrapture");
+
+#if QT_VERSION >= QT_VERSION_CHECK(5, 6, 0)
+  // Pins must survive logout, so the session manager must not close them.
+  app.setFallbackSessionManagementEnabled(false);
+#endif
+
+  QCommandLineParser parser;
+  QCommandLineOption stressOption("stress",
+                                  "Populate the pin with <count> annotations and report paint, pan and hit-test times.",
+                                  "count");
+  QCommandLineOption restoreOption("restore", "Restore the pins of the saved session and keep saving them.");
+  QCommandLineOption sessionOption("session", "Save pins to the session so that --restore can bring them back.");
+  QCommandLineOption hibernateOption("hibernate-after",
+                                     "Compress the pixels of pins left idle for <minutes> (0 disables, default 60).",
+                                     "minutes");
+  QCommandLineOption recordOption("record", "Record the input events of the pin to <file>.", "file");
+  QCommandLineOption replayOption("replay",
+                                  "Replay the input events in <file> on the image and report event and frame times.",
+                                  "file");
+  QCommandLineOption goldenOption("golden",
+                                  "Compare the replayed result with <image>, or write it if missing.",
+                                  "image");
+  QCommandLineOption budgetOption("budget", "Fail the replay if p95 event plus frame time exceeds <ms>.", "ms");
+  QCommandLineOption traceOption("trace",
+                                 "Print input-to-paint latency of every frame and check tiled renders against one pass.");
+  QCommandLineOption rawOption("raw", "Read stdin as raw RGBA pixels of size <width>x<height>.", "size");
+  QCommandLineOption outputOption("output",
+                                  "Write the annotated image to <target> when the pin is closed "
+                                  "(a file, - for stdout or fd:N).",
+                                  "target");
+  QCommandLineOption autoTrimOption("auto-trim",
+                                    "Trim uniform borders of every capture, allowing channels to differ "
+                                    "by up to <tolerance> from the border color.",
+                                    "tolerance");
+  QCommandLineOption statsOption("stats",
+                                 "Print the memory report of every pin to stderr on SIGUSR1 and after --stress.");
+  QCommandLineOption scrollOption("scroll",
+                                  "Keep grabbing the selected region while its content is scrolled "
+                                  "and pin the stitched frames.");
+  QCommandLineOption autoScrollOption("auto-scroll", "With --scroll, scroll the region with fake wheel events.");
+  QCommandLineOption windowOption("window",
+                                  "Click a window to pin its contents as they are, even when other windows cover it.");
+  QCommandLineOption watchOption("watch",
+                                 "Pin every image written or moved into <dir> until interrupted.",
+                                 "dir");
+  QCommandLineOption orderedOption("ordered",
+                                   "With several files, show the pins in argument order instead of as each decode completes.");
+  QCommandLineOption multiOption("multi",
+                                 "Select several regions until cancelled, then pin them all from a single screen grab.");
+
+  parser.addHelpOption();
+  parser.addOption(stressOption);
+  parser.addOption(restoreOption);
+  parser.addOption(sessionOption);
+  parser.addOption(multiOption);
+  parser.addOption(scrollOption);
+  parser.addOption(windowOption);
+  parser.addOption(watchOption);
+  parser.addOption(orderedOption);
+  parser.addOption(autoScrollOption);
+  parser.addOption(autoTrimOption);
+  parser.addOption(hibernateOption);
+  parser.addOption(recordOption);
+  parser.addOption(replayOption);
+  parser.addOption(goldenOption);
+  parser.addOption(budgetOption);
+  parser.addOption(traceOption);
+  parser.addOption(statsOption);
+  parser.addOption(rawOption);
+  parser.addOption(outputOption);
+  parser.addPositionalArgument("files", "Image files to pin, - for stdin. Select a screen region if omitted.",
+                               "[files...]");
+  parser.process(app);
+
+  if((parser.isSet(sessionOption) || parser.isSet(restoreOption)) &&
+     !parser.isSet(stressOption) && !parser.isSet(replayOption))
+    Session::setEnabled(true);
+
+  XRapture::setTrace(parser.isSet(traceOption));
+
+  if(parser.isSet(statsOption) && !MemoryStats::dumpOnSignal(SIGUSR1, XRapture::dumpMemory))
+    std::cerr << "cannot install the SIGUSR1 handler" << std::endl;
+
+  if(parser.isSet(autoTrimOption))
+    XRapture::setAutoTrim(parser.value(autoTrimOption).toInt());
+
+  if(parser.isSet(hibernateOption))
+    XRapture::setHibernateTimeout(parser.value(hibernateOption).toInt() * 60 * 1000);
+
+  auto args = parser.positionalArguments();
+
+  if(parser.isSet(replayOption)) {
+    if(args.isEmpty()) {
+      std::cerr << "--replay needs the image the events were recorded on" << std::endl;
+      return 1;
+    }
+
+    XRapture::setHibernateTimeout(0);
+    XRapture* xrapture = XRapture::createPin();
+    xrapture -> show();
+    if(!xrapture -> openImageFile(args.first())) return 1;
+
+    QTimer::singleShot(0, [&] {
+        EventReplayer replayer(xrapture);
+        bool ok = replayer.run(parser.value(replayOption), parser.value(goldenOption),
+                               parser.value(budgetOption).toDouble());
+        app.exit(ok ? 0 : 1);
+      });
+
+    return app.exec();
+  }
+
+  if(parser.isSet(restoreOption)) {
+    int restored = 0;
+
+    for(auto id: Session::pinIds()) {
+      XRapture* pin = XRapture::createPin();
+
+      if(pin -> restorePin(id)) {
+        pin -> show();
+        ++restored;
+      }
+      else {
+        delete pin;
+      }
+    }
+
+    if(args.isEmpty()) {
+      if(restored == 0) return 0;
+      return app.exec();
+    }
+  }
+
+  if(parser.isSet(watchOption)) {
+    auto loader = new ImageLoader(0, &app);
+    QPoint origin = QGuiApplication::primaryScreen() -> availableGeometry().topLeft();
+    int pinned = 0;
+
+    auto watcher = new FolderWatcher(parser.value(watchOption),
+                                     [&](const QString& path) {
+                                       loader -> load(path,
+                                                      [&](const QString& fileName, const QImage& img) {
+                                                        if(img.isNull()) {
+                                                          std::cerr << "cannot read " << fileName.toStdString() << std::endl;
+                                                          return;
+                                                        }
+
+                                                        XRapture* pin = XRapture::createPin();
+                                                        pin -> move(origin + QPoint(32, 32) * (pinned++ % 10));
+                                                        pin -> show();
+                                                        pin -> openImage(img);
+                                                      }
+                                                      );
+                                     },
+                                     &app);
+
+    if(!watcher -> isWatching()) {
+      std::cerr << "cannot watch " << parser.value(watchOption).toStdString() << std::endl;
+      return 1;
+    }
+
+    app.setQuitOnLastWindowClosed(false);
+    return app.exec();
+  }
+
+  if(args.size() > 1) {
+    if(args.contains("-")) {
+      std::cerr << "- cannot be combined with other files" << std::endl;
+      return 1;
+    }
+
+    // These apply to a single pin.
+    for(auto& option: {outputOption, recordOption, stressOption, multiOption,
+                       windowOption, scrollOption, autoScrollOption, rawOption}) {
+      if(parser.isSet(option)) {
+        std::cerr << "--" << option.names().first().toStdString() << " cannot be combined with several files"
+                  << std::endl;
+        return 1;
+      }
+    }
+
+    // Every file gets its own pin in this process, decoded on all cores.
+    auto loader = new ImageLoader(QThread::idealThreadCount(), &app);
+    QPoint origin = QGuiApplication::primaryScreen() -> availableGeometry().topLeft();
+    bool ordered = parser.isSet(orderedOption);
+    QVector<QImage> decoded(args.size());
+    QVector<bool> ready(args.size(), false);
+    int next = 0;
+    int pinned = 0;
+
+    auto showPin = [&](int index, const QImage& img) {
+      if(img.isNull()) {
+        std::cerr << "cannot read " << args[index].toStdString() << std::endl;
+        return;
+      }
+
+      XRapture* pin = XRapture::createPin();
+      pin -> move(origin + QPoint(32, 32) * (index % 10));
+      pin -> show();
+      pin -> openImage(img);
+      ++pinned;
+    };
+
+    for(int i = 0; i < args.size(); ++i) {
+      loader -> load(args[i],
+                     [&, i](const QString&, const QImage& img) {
+                       if(!ordered) {
+                         showPin(i, img);
+                       }
+                       else {
+                         // Later files wait until every earlier one is shown.
+                         decoded[i] = img;
+                         ready[i] = true;
+                         for(; next < args.size() && ready[next]; ++next) {
+                           showPin(next, decoded[next]);
+                           decoded[next] = QImage();
+                         }
+                       }
+
+                       if(loader -> pending() == 0 && pinned == 0) app.exit(1);
+                     }
+                     );
+    }
+
+    return app.exec();
+  }
+
   slop::SlopSelection selection(0, 0, 0, 0, 0, true);
   slop::SlopOptions options;
   options.border = 2.0;
   options.tolerance = 0.0;
 
-  if(argc == 1) {
+  // Any press then picks the window under the pointer.
+  if(parser.isSet(windowOption)) options.tolerance = 1e6;
+
+  if(args.isEmpty() && parser.isSet(multiOption)) {
+    QList<QRect> rects;
+
+    for(;;) {
+      selection = slop::SlopSelect(&options);
+      if(selection.cancelled) break;
+
+      rects << QRect(selection.x, selection.y, selection.w, selection.h);
+    }
+
+    if(rects.isEmpty()) {
+      std::cerr << "cancelled" << std::endl;
+      return 1;
+    }
+
+    XRapture::captureRegions(rects);
+    return app.exec();
+  }
+
+  if(args.isEmpty()) {
     selection = slop::SlopSelect(&options);
     if(selection.cancelled) {
       std::cerr << "cancelled" << std::endl;
@@ -19,18 +281,66 @@ int main(int argc, char** argv)
     }
   }
 
-  QApplication app(argc, argv);
-  QGraphicsScene scene;
-  XRapture* xrapture = new XRapture(&scene);
+  XRapture* xrapture = XRapture::createPin();
+
+  if(!args.isEmpty() && args.first() == "-") {
+    QSize rawSize;
+    if(parser.isSet(rawOption)) {
+      auto size = parser.value(rawOption).split('x');
+      if(size.size() == 2) rawSize = QSize(size[0].toInt(), size[1].toInt());
+    }
+
+    QImage img = StreamIO::readStdin(rawSize);
+    if(img.isNull()) {
+      std::cerr << "cannot read an image from stdin" << std::endl;
+      return 1;
+    }
 
-  if(argc > 1) {
     xrapture -> show();
-    if(!xrapture -> openImageFile(argv[1])) return 1;
+    xrapture -> openImage(img);
+  }
+  else if(!args.isEmpty()) {
+    xrapture -> show();
+    if(!xrapture -> openImageFile(args.first())) return 1;
+  }
+  else if(parser.isSet(windowOption)) {
+    // Fall back to the screen when the window has no composite pixmap.
+    if(!xrapture -> windowCapture(selection.id))
+      xrapture -> screenCapture(selection.x, selection.y, selection.w, selection.h);
+    xrapture -> show();
+  }
+  else if(parser.isSet(scrollOption) || parser.isSet(autoScrollOption)) {
+    if(!parser.isSet(autoScrollOption))
+      std::cerr << "scroll the selected region; the capture ends when it stops moving" << std::endl;
+
+    xrapture -> scrollCapture(selection.x, selection.y, selection.w, selection.h,
+                              parser.isSet(autoScrollOption));
+    xrapture -> show();
   }
   else {
     xrapture -> screenCapture(selection.x, selection.y, selection.w, selection.h);
     xrapture -> show();
   }
 
+  if(parser.isSet(outputOption))
+    xrapture -> setOutput(parser.value(outputOption));
+
+  if(parser.isSet(recordOption)) {
+    auto recorder = new EventRecorder(xrapture, parser.value(recordOption));
+    if(!recorder -> isOpen()) {
+      std::cerr << "cannot open " << parser.value(recordOption).toStdString() << std::endl;
+      return 1;
+    }
+  }
+
+  if(parser.isSet(stressOption)) {
+    int count = parser.value(stressOption).toInt();
+    bool stats = parser.isSet(statsOption);
+    QTimer::singleShot(0, [=] {
+        xrapture -> runStressTest(count);
+        if(stats) XRapture::dumpMemory();
+      });
+  }
+
   return app.exec();
 }
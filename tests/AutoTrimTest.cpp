@@ -0,0 +1,118 @@
+#include <QtTest>
+#include <random>
+
+#include "AutoTrim.hpp"
+#include "PixelKernels.hpp"
+#include "PixelFormat.hpp"
+
+class AutoTrimTest: public QObject
+{
+  Q_OBJECT
+
+private slots:
+  void mismatchMatchesScalar_data();
+  void mismatchMatchesScalar();
+  void contentRect_data();
+  void contentRect();
+  void uniformImage();
+};
+
+namespace {
+  const quint32 BORDER = 0xfff0e0d0;
+
+  // Border pixels jittered within +-jitter per channel.
+  quint32 jittered(std::mt19937& random, int jitter)
+  {
+    quint32 ret = 0;
+    for(int shift = 0; shift < 32; shift += 8) {
+      int c = int((BORDER >> shift) & 0xff) + int(random() % (2 * jitter + 1)) - jitter;
+      ret |= quint32(qBound(0, c, 255)) << shift;
+    }
+    return ret;
+  }
+
+  // The border with one channel just beyond the tolerance, where possible.
+  quint32 outside(std::mt19937& random, int tolerance)
+  {
+    int shift = 8 * (random() % 4);
+    int c = int((BORDER >> shift) & 0xff);
+    c = c + tolerance + 1 <= 255 ? c + tolerance + 1 : c - tolerance - 1;
+    return (BORDER & ~(0xffu << shift)) | (quint32(qBound(0, c, 255)) << shift);
+  }
+}
+
+void AutoTrimTest::mismatchMatchesScalar_data()
+{
+  QTest::addColumn<int>("width");
+  QTest::addColumn<int>("tolerance");
+
+  QTest::newRow("exact") << 64 << 0;
+  QTest::newRow("tolerant") << 37 << 8;
+  QTest::newRow("short") << 3 << 4;
+  QTest::newRow("loose") << 129 << 255;
+}
+
+void AutoTrimTest::mismatchMatchesScalar()
+{
+  QFETCH(int, width);
+  QFETCH(int, tolerance);
+
+  std::mt19937 random(width * 3 + tolerance);
+  QVector<quint32> row(width);
+
+  for(int round = 0; round < 200; ++round) {
+    // Border pixels within the tolerance and up to two just beyond it.
+    for(auto& px: row) px = jittered(random, tolerance);
+    for(int i = random() % 3; i > 0; --i) row[random() % width] = outside(random, tolerance);
+
+    QCOMPARE(PixelKernels::firstMismatch(row.constData(), width, BORDER, tolerance),
+             PixelKernels::firstMismatchScalar(row.constData(), width, BORDER, tolerance));
+    QCOMPARE(PixelKernels::lastMismatch(row.constData(), width, BORDER, tolerance),
+             PixelKernels::lastMismatchScalar(row.constData(), width, BORDER, tolerance));
+  }
+}
+
+void AutoTrimTest::contentRect_data()
+{
+  QTest::addColumn<QSize>("size");
+  QTest::addColumn<QRect>("content");
+
+  QTest::newRow("centered") << QSize(120, 80) << QRect(30, 20, 41, 17);
+  QTest::newRow("touching left") << QSize(50, 50) << QRect(0, 10, 5, 5);
+  QTest::newRow("touching bottom right") << QSize(33, 21) << QRect(7, 3, 26, 18);
+  QTest::newRow("single pixel") << QSize(64, 64) << QRect(63, 40, 1, 1);
+}
+
+void AutoTrimTest::contentRect()
+{
+  QFETCH(QSize, size);
+  QFETCH(QRect, content);
+
+  std::mt19937 random(size.width() + content.x());
+  QImage image(size, PixelFormat::CANONICAL);
+
+  for(int y = 0; y < image.height(); ++y) {
+    auto line = reinterpret_cast<quint32*>(image.scanLine(y));
+    for(int x = 0; x < image.width(); ++x)
+      line[x] = content.contains(x, y) ? 0xff000000 | random() : jittered(random, 4);
+  }
+  // The border color is taken from the top left pixel.
+  reinterpret_cast<quint32*>(image.scanLine(0))[0] = BORDER;
+
+  // Content pixels that happen to match the border do not matter as long as
+  // the corners of the content differ.
+  image.setPixel(content.topLeft(), 0xff000000);
+  image.setPixel(content.bottomRight(), 0xff000000);
+
+  QCOMPARE(AutoTrim::contentRect(image, 8), content);
+}
+
+void AutoTrimTest::uniformImage()
+{
+  QImage image(40, 30, PixelFormat::CANONICAL);
+  image.fill(BORDER);
+  QVERIFY(AutoTrim::contentRect(image).isNull());
+}
+
+QTEST_MAIN(AutoTrimTest)
+#include "AutoTrimTest.moc"
@@ -0,0 +1,123 @@
+#include <QtTest>
+#include <random>
+
+#include "ImageCompare.hpp"
+#include "PixelKernels.hpp"
+#include "PixelFormat.hpp"
+
+class ImageCompareTest: public QObject
+{
+  Q_OBJECT
+
+private slots:
+  void diffRowMatchesScalar_data();
+  void diffRowMatchesScalar();
+  void identical();
+  void changedBlock();
+  void sizeMismatch();
+};
+
+namespace {
+  QImage noise(const QSize& size, int seed)
+  {
+    std::mt19937 random(seed);
+    QImage ret(size, PixelFormat::CANONICAL);
+    for(int y = 0; y < ret.height(); ++y) {
+      auto line = reinterpret_cast<QRgb*>(ret.scanLine(y));
+      for(int x = 0; x < ret.width(); ++x) line[x] = random() | 0xff000000;
+    }
+    return ret;
+  }
+}
+
+void ImageCompareTest::diffRowMatchesScalar_data()
+{
+  QTest::addColumn<int>("width");
+  QTest::addColumn<int>("threshold");
+
+  QTest::newRow("exact") << 64 << 0;
+  QTest::newRow("threshold") << 67 << 10;
+  QTest::newRow("short") << 3 << 0;
+  QTest::newRow("high threshold") << 100 << 254;
+}
+
+void ImageCompareTest::diffRowMatchesScalar()
+{
+  QFETCH(int, width);
+  QFETCH(int, threshold);
+
+  std::mt19937 random(width + threshold);
+  QVector<quint32> a(width), b(width);
+  int tiles = (width + 15) / 16;
+
+  for(int round = 0; round < 200; ++round) {
+    // Mostly one channel moved by about the threshold, sometimes unrelated.
+    for(int x = 0; x < width; ++x) {
+      a[x] = random();
+      int shift = 8 * (random() % 4);
+      int c = (a[x] >> shift) & 0xff;
+      int d = qMax(threshold + int(random() % 3) - 1, 0);
+      int moved = c + d <= 255 ? c + d : c - d;
+      b[x] = (a[x] & ~(0xffu << shift)) | (quint32(qBound(0, moved, 255)) << shift);
+      if(random() % 50 == 0) b[x] = random();
+    }
+
+    QVector<quint32> heat(width, 0xdeadbeef), refHeat(width, 0xdeadbeef);
+    QVector<uchar> tile(tiles, 0), refTile(tiles, 0);
+
+    int changed = PixelKernels::diffRow(a.constData(), b.constData(), heat.data(), tile.data(), width, threshold);
+    int refChanged = PixelKernels::diffRowScalar(a.constData(), b.constData(), refHeat.data(), refTile.data(),
+                                                 width, threshold);
+
+    QCOMPARE(changed, refChanged);
+    QCOMPARE(heat, refHeat);
+    QCOMPARE(tile, refTile);
+  }
+}
+
+void ImageCompareTest::identical()
+{
+  QImage image = noise(QSize(100, 70), 1);
+  auto result = ImageCompare::compare(image, image.copy());
+
+  QCOMPARE(result.changedPixels, qint64(0));
+  QVERIFY(result.regions.isEmpty());
+  QCOMPARE(result.heatmap.size(), image.size());
+}
+
+void ImageCompareTest::changedBlock()
+{
+  QImage a = noise(QSize(100, 70), 2);
+  QImage b = a.copy();
+  for(int y = 40; y < 43; ++y)
+    for(int x = 50; x < 53; ++x) b.setPixel(x, y, b.pixel(x, y) ^ 0x00808080);
+
+  auto result = ImageCompare::compare(a, b, 8);
+
+  QCOMPARE(result.changedPixels, qint64(9));
+  QCOMPARE(result.regions.size(), 1);
+  QVERIFY(result.regions[0].contains(QRect(50, 40, 3, 3)));
+  QCOMPARE(qAlpha(result.heatmap.pixel(51, 41)), 255);
+  QCOMPARE(qAlpha(result.heatmap.pixel(10, 10)), 0);
+
+  // Below the threshold nothing is reported.
+  QCOMPARE(ImageCompare::compare(a, b, 128).changedPixels, qint64(0));
+}
+
+void ImageCompareTest::sizeMismatch()
+{
+  // Everything outside the overlap of the two images counts as changed.
+  QImage a = noise(QSize(40, 30), 3);
+  QImage b = a.copy(0, 0, 50, 20);
+
+  auto result = ImageCompare::compare(a, b);
+
+  QCOMPARE(result.heatmap.size(), QSize(50, 30));
+  QCOMPARE(result.changedPixels, qint64(50 * 30 - 40 * 20));
+  QCOMPARE(qAlpha(result.heatmap.pixel(45, 5)), 255);
+  QCOMPARE(qAlpha(result.heatmap.pixel(5, 25)), 255);
+  QCOMPARE(qAlpha(result.heatmap.pixel(5, 5)), 0);
+}
+
+QTEST_MAIN(ImageCompareTest)
+#include "ImageCompareTest.moc"
@@ -0,0 +1,128 @@
+#include <QtTest>
+#include <QTemporaryDir>
+#include <QFile>
+
+#include "Journal.hpp"
+
+class JournalTest: public QObject
+{
+  Q_OBJECT
+
+private slots:
+  void init();
+  void appendAndRead();
+  void corruptRecordEndsJournal();
+  void tornRecordEndsJournal();
+  void truncate();
+
+private:
+  QByteArray readFile();
+  void writeFile(const QByteArray& data);
+
+  QScopedPointer<QTemporaryDir> dir_;
+  QString path_;
+};
+
+namespace {
+  // size, checksum, seq and op before each payload.
+  const int RECORD_OVERHEAD = 15;
+  const int PAYLOAD_SIZE = 20;
+
+  QByteArray payload(int i)
+  {
+    return QByteArray(PAYLOAD_SIZE, char('a' + i));
+  }
+}
+
+void JournalTest::init()
+{
+  dir_.reset(new QTemporaryDir);
+  QVERIFY(dir_ -> isValid());
+  path_ = dir_ -> filePath("journal");
+
+  Journal journal;
+  journal.open(path_, 0);
+  for(int i = 0; i < 3; ++i) journal.append(Journal::ADD + i, payload(i));
+  journal.close();
+}
+
+QByteArray JournalTest::readFile()
+{
+  QFile file(path_);
+  file.open(QIODevice::ReadOnly);
+  return file.readAll();
+}
+
+void JournalTest::writeFile(const QByteArray& data)
+{
+  QFile file(path_);
+  QVERIFY(file.open(QIODevice::WriteOnly | QIODevice::Truncate));
+  file.write(data);
+}
+
+void JournalTest::appendAndRead()
+{
+  QCOMPARE(readFile().size(), 3 * (RECORD_OVERHEAD + PAYLOAD_SIZE));
+
+  auto records = Journal::read(path_);
+  QCOMPARE(records.size(), 3);
+  for(int i = 0; i < 3; ++i) {
+    QCOMPARE(records[i].seq, quint64(i + 1));
+    QCOMPARE(int(records[i].op), Journal::ADD + i);
+    QCOMPARE(records[i].payload, payload(i));
+  }
+}
+
+void JournalTest::corruptRecordEndsJournal()
+{
+  // A flipped payload byte of the second record fails its checksum.
+  QByteArray data = readFile();
+  data[RECORD_OVERHEAD + PAYLOAD_SIZE + RECORD_OVERHEAD + 3] ^= 0x10;
+  writeFile(data);
+
+  auto records = Journal::read(path_);
+  QCOMPARE(records.size(), 1);
+  QCOMPARE(records[0].payload, payload(0));
+}
+
+void JournalTest::tornRecordEndsJournal()
+{
+  QByteArray data = readFile();
+  writeFile(data.left(data.size() - 1));
+  QCOMPARE(Journal::read(path_).size(), 2);
+
+  // A size field that runs past the end of the file.
+  data = data.left(RECORD_OVERHEAD + PAYLOAD_SIZE);
+  data += QByteArray::fromHex("7fffffff0000");
+  writeFile(data);
+  QCOMPARE(Journal::read(path_).size(), 1);
+}
+
+void JournalTest::truncate()
+{
+  Journal journal;
+  journal.open(path_, 3);
+  QCOMPARE(journal.size(), qint64(3 * (RECORD_OVERHEAD + PAYLOAD_SIZE)));
+
+  journal.append(Journal::REMOVE, payload(3));
+  journal.truncate();
+  QCOMPARE(journal.size(), qint64(0));
+
+  journal.append(Journal::TRANSFORM, payload(4));
+  journal.close();
+
+  auto records = Journal::read(path_);
+  QCOMPARE(records.size(), 1);
+  QCOMPARE(records[0].seq, quint64(5));
+  QCOMPARE(int(records[0].op), int(Journal::TRANSFORM));
+  QCOMPARE(records[0].payload, payload(4));
+
+  journal.open(path_, 5);
+  journal.truncate();
+  journal.close();
+  QVERIFY(readFile().isEmpty());
+  QVERIFY(Journal::read(path_).isEmpty());
+}
+
+QTEST_MAIN(JournalTest)
+#include "JournalTest.moc"
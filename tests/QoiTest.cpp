@@ -0,0 +1,95 @@
+#include <QtTest>
+#include <random>
+
+#include "Qoi.hpp"
+
+class QoiTest: public QObject
+{
+  Q_OBJECT
+
+private slots:
+  void roundTrip_data();
+  void roundTrip();
+  void rejectsBadHeader();
+  void rejectsOversizedImages();
+};
+
+namespace {
+  enum Content {
+    NOISE,
+    RUNS,
+    GRADIENT,
+  };
+
+  QImage makeImage(const QSize& size, QImage::Format format, Content content, bool alpha)
+  {
+    std::mt19937 random(size.width() * 131 + size.height() + content);
+    QImage ret(size, QImage::Format_ARGB32);
+
+    for(int y = 0; y < ret.height(); ++y) {
+      auto line = reinterpret_cast<QRgb*>(ret.scanLine(y));
+      for(int x = 0; x < ret.width(); ++x) {
+        QRgb px = random();
+        if(content == RUNS) px = (x / 70 + y) % 3 == 0 ? 0xff204080 : px;
+        if(content == GRADIENT) px = qRgba(x + y, x * 2, 255 - x - y / 4, 255);
+        line[x] = alpha ? px : px | 0xff000000;
+      }
+    }
+
+    return ret.convertToFormat(format);
+  }
+}
+
+void QoiTest::roundTrip_data()
+{
+  QTest::addColumn<QImage>("image");
+
+  QTest::newRow("opaque noise") << makeImage(QSize(67, 31), QImage::Format_RGB32, NOISE, false);
+  QTest::newRow("straight alpha") << makeImage(QSize(64, 40), QImage::Format_ARGB32, NOISE, true);
+  QTest::newRow("premultiplied") << makeImage(QSize(45, 45), QImage::Format_ARGB32_Premultiplied, NOISE, true);
+  QTest::newRow("long runs") << makeImage(QSize(300, 9), QImage::Format_RGB32, RUNS, false);
+  QTest::newRow("gradient") << makeImage(QSize(128, 64), QImage::Format_ARGB32_Premultiplied, GRADIENT, false);
+  QTest::newRow("single pixel") << makeImage(QSize(1, 1), QImage::Format_ARGB32, NOISE, true);
+}
+
+void QoiTest::roundTrip()
+{
+  QFETCH(QImage, image);
+
+  QByteArray data = Qoi::encode(image);
+  QImage decoded = Qoi::decode(data);
+
+  QCOMPARE(decoded.size(), image.size());
+  QCOMPARE(decoded.format(), QImage::Format_ARGB32_Premultiplied);
+  QVERIFY(decoded == image.convertToFormat(QImage::Format_ARGB32_Premultiplied));
+}
+
+void QoiTest::rejectsBadHeader()
+{
+  QByteArray data = Qoi::encode(makeImage(QSize(8, 8), QImage::Format_RGB32, NOISE, false));
+  QVERIFY(!Qoi::decode(data).isNull());
+
+  QByteArray magic = data;
+  magic[0] = 'x';
+  QVERIFY(Qoi::decode(magic).isNull());
+
+  QByteArray empty = data;
+  empty[4] = empty[5] = empty[6] = empty[7] = 0;
+  QVERIFY(Qoi::decode(empty).isNull());
+
+  QVERIFY(Qoi::decode(data.left(10)).isNull());
+}
+
+void QoiTest::rejectsOversizedImages()
+{
+  // decode() refuses sides over 65535, so encode() must not write them.
+  QImage wide(65536, 1, QImage::Format_RGB32);
+  wide.fill(0xff102030);
+  QVERIFY(Qoi::encode(wide).isEmpty());
+
+  QImage widest = wide.copy(0, 0, 65535, 1);
+  QCOMPARE(Qoi::decode(Qoi::encode(widest)).size(), widest.size());
+}
+
+QTEST_MAIN(QoiTest)
+#include "QoiTest.moc"
@@ -0,0 +1,115 @@
+#include <QtTest>
+#include <random>
+
+#include "Quantize.hpp"
+#include "PixelKernels.hpp"
+#include "PixelFormat.hpp"
+
+class QuantizeTest: public QObject
+{
+  Q_OBJECT
+
+private slots:
+  void nearestMatchesScalar_data();
+  void nearestMatchesScalar();
+  void exactIsLossless();
+  void exactRejectsTooManyColors();
+  void ditheredStaysInPalette();
+};
+
+namespace {
+  // Opaque noise from a fixed set of colors, with a transparent run.
+  QImage noise(const QSize& size, int colors)
+  {
+    std::mt19937 random(size.width() * 17 + colors);
+    QVector<QRgb> palette(colors);
+    for(auto& c: palette) c = random() | 0xff000000;
+
+    QImage ret(size, PixelFormat::CANONICAL);
+    for(int y = 0; y < ret.height(); ++y) {
+      auto line = reinterpret_cast<QRgb*>(ret.scanLine(y));
+      for(int x = 0; x < ret.width(); ++x) line[x] = palette[random() % colors];
+    }
+    for(int x = 0; x < ret.width() / 4; ++x) ret.setPixel(x, ret.height() / 2, 0);
+    return ret;
+  }
+}
+
+void QuantizeTest::nearestMatchesScalar_data()
+{
+  QTest::addColumn<int>("count");
+
+  QTest::newRow("one") << 1;
+  QTest::newRow("three") << 3;
+  QTest::newRow("sixteen") << 16;
+  QTest::newRow("odd") << 37;
+  QTest::newRow("full") << 255;
+}
+
+void QuantizeTest::nearestMatchesScalar()
+{
+  QFETCH(int, count);
+
+  // A coarse palette has many equally near entries, which must resolve to
+  // the lowest index like the scalar loop does.
+  std::mt19937 random(count);
+  QVector<qint16> r(count), g(count), b(count);
+  for(int i = 0; i < count; ++i) {
+    r[i] = random() % 4 * 85;
+    g[i] = random() % 4 * 85;
+    b[i] = random() % 8 * 36;
+  }
+
+  for(int round = 0; round < 2000; ++round) {
+    int pr = random() % 256, pg = random() % 256, pb = random() % 256;
+    QCOMPARE(PixelKernels::nearestColor(r.constData(), g.constData(), b.constData(), count, pr, pg, pb),
+             PixelKernels::nearestColorScalar(r.constData(), g.constData(), b.constData(), count, pr, pg, pb));
+  }
+}
+
+void QuantizeTest::exactIsLossless()
+{
+  QImage image = noise(QSize(97, 41), 200);
+  QImage indexed = Quantize::exact(image);
+
+  QCOMPARE(indexed.format(), QImage::Format_Indexed8);
+  QVERIFY(indexed.colorCount() <= 201);
+  QVERIFY(indexed.convertToFormat(PixelFormat::CANONICAL) == image);
+}
+
+void QuantizeTest::exactRejectsTooManyColors()
+{
+  QImage image(257, 1, PixelFormat::CANONICAL);
+  for(int x = 0; x < image.width(); ++x) image.setPixel(x, 0, qRgb(x % 256, x / 256, 7));
+
+  QVERIFY(Quantize::exact(image).isNull());
+  QVERIFY(!Quantize::exact(image.copy(0, 0, 256, 1)).isNull());
+  QVERIFY(Quantize::exact(image.copy(0, 0, 16, 1), 15).isNull());
+}
+
+void QuantizeTest::ditheredStaysInPalette()
+{
+  QImage image = noise(QSize(120, 90), 4000);
+  QImage indexed = Quantize::dithered(image, 16);
+
+  QCOMPARE(indexed.format(), QImage::Format_Indexed8);
+  QCOMPARE(indexed.size(), image.size());
+  QVERIFY(indexed.colorCount() > 1);
+  QVERIFY(indexed.colorCount() <= 16);
+
+  // Transparent pixels map to the transparent entry at the end.
+  QRgb last = indexed.color(indexed.colorCount() - 1);
+  QCOMPARE(qAlpha(last), 0);
+
+  for(int y = 0; y < indexed.height(); ++y) {
+    const uchar* line = indexed.constScanLine(y);
+    auto in = reinterpret_cast<const QRgb*>(image.constScanLine(y));
+    for(int x = 0; x < indexed.width(); ++x) {
+      QVERIFY(line[x] < indexed.colorCount());
+      QCOMPARE(line[x] == indexed.colorCount() - 1, qAlpha(in[x]) == 0);
+    }
+  }
+}
+
+QTEST_MAIN(QuantizeTest)
+#include "QuantizeTest.moc"
@@ -0,0 +1,128 @@
+#include <QtTest>
+#include <random>
+
+#include "Resample.hpp"
+#include "PixelKernels.hpp"
+#include "PixelFormat.hpp"
+
+class ResampleTest: public QObject
+{
+  Q_OBJECT
+
+private slots:
+  void rowMatchesScalar_data();
+  void rowMatchesScalar();
+  void columnsMatchScalar_data();
+  void columnsMatchScalar();
+  void uniformStaysUniform();
+};
+
+namespace {
+  QVector<quint32> randomPixels(int count, std::mt19937& random)
+  {
+    QVector<quint32> ret(count);
+    for(auto& px: ret) px = qPremultiply(random());
+    return ret;
+  }
+
+  // Q14 weights summing to one, with negative lobes large enough to push
+  // channels out of range.
+  QVector<qint16> randomWeights(int count, int taps, std::mt19937& random)
+  {
+    QVector<qint16> ret(count * taps);
+    for(int i = 0; i < count; ++i) {
+      qint16* w = ret.data() + i * taps;
+      int total = 0;
+      for(int j = 1; j < taps; ++j) {
+        w[j] = int(random() % 6000) - 2000;
+        total += w[j];
+      }
+      w[0] = (1 << 14) - total;
+    }
+    return ret;
+  }
+}
+
+void ResampleTest::rowMatchesScalar_data()
+{
+  QTest::addColumn<int>("src");
+  QTest::addColumn<int>("taps");
+
+  QTest::newRow("even taps") << 100 << 6;
+  QTest::newRow("odd taps") << 37 << 7;
+  QTest::newRow("one tap") << 9 << 1;
+  QTest::newRow("all taps") << 5 << 5;
+}
+
+void ResampleTest::rowMatchesScalar()
+{
+  QFETCH(int, src);
+  QFETCH(int, taps);
+
+  std::mt19937 random(src * 7 + taps);
+  const int width = 61;
+  auto row = randomPixels(src, random);
+  auto weights = randomWeights(width, taps, random);
+
+  QVector<int> begin(width);
+  for(auto& b: begin) b = random() % (src - taps + 1);
+
+  QVector<quint32> out(width), ref(width);
+  PixelKernels::resampleRow(row.constData(), out.data(), width, begin.constData(), weights.constData(), taps);
+  PixelKernels::resampleRowScalar(row.constData(), ref.data(), width, begin.constData(), weights.constData(), taps);
+
+  QCOMPARE(out, ref);
+}
+
+void ResampleTest::columnsMatchScalar_data()
+{
+  QTest::addColumn<int>("taps");
+  QTest::addColumn<int>("width");
+
+  QTest::newRow("even taps") << 6 << 37;
+  QTest::newRow("odd taps") << 7 << 16;
+  QTest::newRow("narrow") << 3 << 3;
+  QTest::newRow("one tap") << 1 << 9;
+}
+
+void ResampleTest::columnsMatchScalar()
+{
+  QFETCH(int, taps);
+  QFETCH(int, width);
+
+  std::mt19937 random(taps * 11 + width);
+  QVector<QVector<quint32>> image;
+  QVector<const quint32*> rows;
+  for(int j = 0; j < taps; ++j) image << randomPixels(width, random);
+  for(auto& row: image) rows << row.constData();
+
+  for(int round = 0; round < 50; ++round) {
+    auto weights = randomWeights(1, taps, random);
+
+    QVector<quint32> out(width), ref(width);
+    PixelKernels::resampleColumns(rows.constData(), out.data(), width, weights.constData(), taps);
+    PixelKernels::resampleColumnsScalar(rows.constData(), ref.data(), width, weights.constData(), taps);
+
+    QCOMPARE(out, ref);
+  }
+}
+
+void ResampleTest::uniformStaysUniform()
+{
+  QImage image(53, 29, PixelFormat::CANONICAL);
+  QRgb color = qPremultiply(qRgba(200, 100, 50, 180));
+  image.fill(color);
+
+  for(auto size: {QSize(17, 80), QSize(120, 11), QSize(1, 1)}) {
+    QImage scaled = Resample::scaled(image, size);
+    QCOMPARE(scaled.size(), size);
+
+    for(int y = 0; y < scaled.height(); ++y) {
+      auto line = reinterpret_cast<const QRgb*>(scaled.constScanLine(y));
+      for(int x = 0; x < scaled.width(); ++x) QCOMPARE(line[x], color);
+    }
+  }
+}
+
+QTEST_MAIN(ResampleTest)
+#include "ResampleTest.moc"
@@ -0,0 +1,121 @@
+#include <QtTest>
+#include <QPainter>
+#include <random>
+
+#include "ScrollStitcher.hpp"
+#include "PixelFormat.hpp"
+
+class ScrollStitcherTest: public QObject
+{
+  Q_OBJECT
+
+private slots:
+  void stitchesScrolledFrames_data();
+  void stitchesScrolledFrames();
+  void rejectsFramesWithoutOverlap();
+  void stopsAtMaxHeight();
+};
+
+namespace {
+  const int WIDTH = 41;
+  const int HEADER = 10;
+  const int VIEW = 80;
+  const int FOOTER = 6;
+
+  QImage noise(int height, int seed)
+  {
+    std::mt19937 random(seed);
+    QImage ret(WIDTH, height, PixelFormat::CANONICAL);
+    for(int y = 0; y < ret.height(); ++y) {
+      auto line = reinterpret_cast<QRgb*>(ret.scanLine(y));
+      for(int x = 0; x < ret.width(); ++x) line[x] = random() | 0xff000000;
+    }
+    return ret;
+  }
+
+  // A window with a fixed header and footer around a view of the document
+  // scrolled down by offset rows.
+  QImage frame(const QImage& header, const QImage& document, const QImage& footer, int offset)
+  {
+    QImage ret(WIDTH, HEADER + VIEW + FOOTER, PixelFormat::CANONICAL);
+    QPainter painter(&ret);
+    painter.setCompositionMode(QPainter::CompositionMode_Source);
+    painter.drawImage(0, 0, header);
+    painter.drawImage(QPoint(0, HEADER), document, QRect(0, offset, WIDTH, VIEW));
+    painter.drawImage(0, HEADER + VIEW, footer);
+    painter.end();
+    return ret;
+  }
+}
+
+void ScrollStitcherTest::stitchesScrolledFrames_data()
+{
+  QTest::addColumn<QList<int>>("offsets");
+
+  QTest::newRow("steady") << (QList<int>() << 0 << 30 << 60 << 90 << 120);
+  QTest::newRow("uneven") << (QList<int>() << 0 << 1 << 50 << 129 << 130 << 200);
+}
+
+void ScrollStitcherTest::stitchesScrolledFrames()
+{
+  QFETCH(QList<int>, offsets);
+
+  QImage header = noise(HEADER, 1);
+  QImage document = noise(400, 2);
+  QImage footer = noise(FOOTER, 3);
+
+  ScrollStitcher stitcher;
+  for(int offset: offsets) QVERIFY(stitcher.addFrame(frame(header, document, footer, offset)));
+  QCOMPARE(stitcher.frames(), offsets.size());
+
+  int scrolled = offsets.last();
+  QImage expected(WIDTH, HEADER + VIEW + scrolled + FOOTER, PixelFormat::CANONICAL);
+  QPainter painter(&expected);
+  painter.setCompositionMode(QPainter::CompositionMode_Source);
+  painter.drawImage(0, 0, header);
+  painter.drawImage(QPoint(0, HEADER), document, QRect(0, 0, WIDTH, VIEW + scrolled));
+  painter.drawImage(0, HEADER + VIEW + scrolled, footer);
+  painter.end();
+
+  QCOMPARE(stitcher.height(), expected.height());
+  QVERIFY(stitcher.result() == expected);
+}
+
+void ScrollStitcherTest::rejectsFramesWithoutOverlap()
+{
+  QImage header = noise(HEADER, 1);
+  QImage document = noise(400, 2);
+  QImage footer = noise(FOOTER, 3);
+
+  ScrollStitcher stitcher;
+  QVERIFY(stitcher.addFrame(frame(header, document, footer, 0)));
+
+  // Unchanged, scrolled past the view, or scrolled back up.
+  QVERIFY(!stitcher.addFrame(frame(header, document, footer, 0)));
+  QVERIFY(!stitcher.addFrame(frame(header, document, footer, VIEW + 10)));
+  QVERIFY(stitcher.addFrame(frame(header, document, footer, 40)));
+  QVERIFY(!stitcher.addFrame(frame(header, document, footer, 20)));
+
+  QCOMPARE(stitcher.frames(), 2);
+  QCOMPARE(stitcher.height(), HEADER + VIEW + 40 + FOOTER);
+}
+
+void ScrollStitcherTest::stopsAtMaxHeight()
+{
+  QImage header = noise(HEADER, 1);
+  QImage document = noise(400, 2);
+  QImage footer = noise(FOOTER, 3);
+
+  const int maxHeight = 150;
+  ScrollStitcher stitcher(maxHeight);
+  for(int offset = 0; offset <= 200 && !stitcher.isFull(); offset += 25)
+    stitcher.addFrame(frame(header, document, footer, offset));
+
+  QVERIFY(stitcher.isFull());
+  QCOMPARE(stitcher.height(), maxHeight);
+  QCOMPARE(stitcher.result().height(), maxHeight);
+  QVERIFY(!stitcher.addFrame(frame(header, document, footer, 225)));
+}
+
+QTEST_MAIN(ScrollStitcherTest)
+#include "ScrollStitcherTest.moc"
@@ -0,0 +1,75 @@
+#include <QtTest>
+#include <QGraphicsScene>
+#include <QGraphicsPixmapItem>
+#include <QGraphicsPathItem>
+#include <QGraphicsRectItem>
+#include <QThreadPool>
+#include <random>
+
+#include "TiledRender.hpp"
+#include "PixelFormat.hpp"
+#include "CachedTextItem.hpp"
+
+class TiledRenderTest: public QObject
+{
+  Q_OBJECT
+
+private slots:
+  void tiledMatchesSinglePass_data();
+  void tiledMatchesSinglePass();
+};
+
+void TiledRenderTest::tiledMatchesSinglePass_data()
+{
+  QTest::addColumn<QSize>("size");
+  QTest::addColumn<int>("tileSize");
+
+  QTest::newRow("exact tiles") << QSize(512, 256) << 128;
+  QTest::newRow("partial tiles") << QSize(1000, 700) << 96;
+  QTest::newRow("small tiles") << QSize(300, 200) << 17;
+}
+
+void TiledRenderTest::tiledMatchesSinglePass()
+{
+  QFETCH(QSize, size);
+  QFETCH(int, tileSize);
+
+  std::mt19937 random(size.width() * 31 + tileSize);
+  QImage base(size, PixelFormat::CANONICAL);
+  for(int y = 0; y < base.height(); ++y) {
+    auto line = reinterpret_cast<QRgb*>(base.scanLine(y));
+    for(int x = 0; x < base.width(); ++x) line[x] = random() | 0xff000000;
+  }
+
+  QGraphicsScene scene(0, 0, size.width(), size.height());
+  auto pixmapItem = scene.addPixmap(PixelFormat::toPixmap(base, "test"));
+  pixmapItem -> setTransformationMode(Qt::SmoothTransformation);
+
+  QPainterPath path;
+  path.moveTo(3.5, 4.25);
+  path.cubicTo(size.width(), 0, 0, size.height(), size.width() - 7.5, size.height() - 3.25);
+  scene.addPath(path, QPen(QColor(255, 0, 0, 128), 6, Qt::SolidLine, Qt::RoundCap));
+  scene.addRect(QRectF(10.5, 20.5, size.width() / 2.0, size.height() / 3.0), QPen(Qt::blue, 3), QColor(0, 255, 0, 64));
+
+  auto text = new CachedTextItem("tiled");
+  text -> setFont(QFont("Sans", 40));
+  text -> setPen(QPen(Qt::white));
+  text -> setBrush(Qt::black);
+  text -> setPos(size.width() / 3.0 + 0.5, size.height() / 2.0);
+  scene.addItem(text);
+
+  // A second pixmap item with an offset, like a blur rect.
+  auto patch = scene.addPixmap(PixelFormat::toPixmap(base.copy(0, 0, 64, 64), "test"));
+  patch -> setOffset(size.width() - 80, 8);
+
+  QRect rect(0, 0, size.width(), size.height());
+  auto entries = TiledRender::snapshot(&scene, rect);
+  QImage single = TiledRender::render(entries, rect, std::max(size.width(), size.height()));
+  QImage tiled = TiledRender::render(entries, rect, tileSize);
+
+  QCOMPARE(tiled.size(), single.size());
+  QVERIFY(tiled == single);
+}
+
+QTEST_MAIN(TiledRenderTest)
+#include "TiledRenderTest.moc"